@@ -5,59 +5,115 @@
 
 namespace carescript {
 
+// returns the variable named by `name` if it has the type _Tp, nullptr otherwise
+template<ScriptValueType _Tp>
+inline _Tp* variable_as(const ScriptVariable& name, ScriptSettings& settings) {
+    auto found = settings.variables.find(get_value<ScriptNameValue>(name));
+    if(found == settings.variables.end() || !is_typeof<_Tp>(found->second)) return nullptr;
+    return (_Tp*)found->second.value.get();
+}
+
+// checks an index argument against the size of a collection
+inline bool valid_index(const ScriptVariable& index, size_t size, ScriptSettings& settings) {
+    long double idx = get_value<ScriptNumberValue>(index);
+    if(idx != (long long)idx) settings.error_msg = "index is not an integer";
+    else if(idx < 0) settings.error_msg = "index underflow";
+    else if(idx >= size) settings.error_msg = "index overflow";
+    return settings.error_msg == "";
+}
+
+// literal syntax: [value, ...]
+inline ScriptValue* parse_list_literal(KittenToken src, ScriptSettings& settings) {
+    if(src.str || src.src.size() < 2 || src.src.front() != '[' || src.src.back() != ']') return nullptr;
+    ScriptArglist elements = parse_argumentlist(src.src,settings);
+    if(settings.error_msg != "") return nullptr;
+    return new ScriptListValue(elements);
+}
+
+// literal syntax: {"key": value, ...}
+inline ScriptValue* parse_map_literal(KittenToken src, ScriptSettings& settings) {
+    if(src.str || src.src.size() < 2 || src.src.front() != '{' || src.src.back() != '}') return nullptr;
+    KittenLexer entry_lexer = KittenLexer()
+        .add_capsule('(',')')
+        .add_capsule('[',']')
+        .add_capsule('{','}')
+        .add_stringq('"')
+        .add_ignore(' ')
+        .add_ignore('\t')
+        .add_ignore('\n')
+        .ignore_backslash_opts()
+        .add_extract(',')
+        .add_extract(':')
+        .erase_empty();
+    auto lexed = entry_lexer.lex(src.src.substr(1,src.src.size()-2));
+    lexed.push_back(KittenToken{","});
+
+    ScriptMapValue::storage entries;
+    std::string key, value;
+    bool in_value = false;
+    for(auto i : lexed) {
+        if(!i.str && i.src == ",") {
+            if(key == "" && !in_value) continue;
+            if(!in_value || value == "") {
+                settings.error_msg = "map entry without value: " + key;
+                return nullptr;
+            }
+            ScriptVariable k = evaluate_expression(key,settings);
+            if(settings.error_msg != "") return nullptr;
+            if(!is_typeof<ScriptStringValue>(k)) {
+                settings.error_msg = "map keys must be strings (got: " + k.get_type() + ")";
+                return nullptr;
+            }
+            ScriptVariable v = evaluate_expression(value,settings);
+            if(settings.error_msg != "") return nullptr;
+            entries[get_value<ScriptStringValue>(k)] = v;
+            key = value = "";
+            in_value = false;
+        }
+        else if(!i.str && i.src == ":" && !in_value) {
+            in_value = true;
+        }
+        else {
+            if(i.str) i.src = "\"" + i.src + "\"";
+            (in_value ? value : key) += " " + i.src;
+        }
+    }
+    return new ScriptMapValue(entries);
+}
+
 inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
     {"set",{2,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-        cc_builtin_if_ignore();
         cc_builtin_var_requires(args[0],ScriptNameValue);
         cc_builtin_var_not_requires(args[1],ScriptNameValue);
         settings.variables[get_value<ScriptNameValue>(args[0])] = args[1];
         return script_null;
     }}},
+    // if, else and endif are resolved by compile_label and handled by run_label,
+    // these only catch uses inside of expressions
     {"if",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-        if(!settings.should_run.empty() && !settings.should_run.top()) {
-            ++settings.ignore_endifs;
-            return script_null; 
-        }
-        
-        cc_builtin_var_requires(args[0],ScriptNumberValue);
-        
-        settings.should_run.push(get_value<ScriptNumberValue>(args[0]) == true);
-        return script_null;
+        _cc_error("can only be used as a statement");
     }}},
     {"else",{0,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-        if(settings.should_run.empty()) {
-            _cc_error("no if");
-        }
-        settings.should_run.top() = !settings.should_run.top();
-        return script_null;
+        _cc_error("can only be used as a statement");
     }}},
     {"endif",{0,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-        if(settings.ignore_endifs != 0) {
-            --settings.ignore_endifs;
-            return script_null;
-        }
-        if(settings.should_run.empty()) _cc_error("no if");
-        settings.should_run.pop();
-        return script_null;
+        _cc_error("can only be used as a statement");
     }}},
     
     {"echo",{-1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-        cc_builtin_if_ignore();
         for(auto i : args) {
-            std::cout << i.printable();
+            *settings.interpreter.output << i.printable();
         }
         return script_null;
     }}},
     {"echoln",{-1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-        cc_builtin_if_ignore();
         for(auto i : args) {
-            std::cout << i.printable();
+            *settings.interpreter.output << i.printable();
         }
-        std::cout << "\n";
+        *settings.interpreter.output << "\n";
         return script_null;
     }}},
     {"input",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-        cc_builtin_if_ignore();
         cc_builtin_var_requires(args[0],ScriptStringValue);
         std::cout << get_value<ScriptStringValue>(args[0]); std::cout.flush();
         std::string inp;
@@ -66,7 +122,6 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
     }}},
 
     {"to_number",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-        cc_builtin_if_ignore();
         cc_builtin_var_requires(args[0],ScriptNumberValue,ScriptStringValue);
         if(is_typeof<ScriptNumberValue>(args[0])) return args[0];
         long double num = 0;
@@ -83,7 +138,6 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
         return new ScriptNumberValue(num);
     }}},
     {"to_string",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-        cc_builtin_if_ignore();
         cc_builtin_var_requires(args[0],ScriptNumberValue,ScriptStringValue);
         if(is_typeof<ScriptNumberValue>(args[0])) {
             return new ScriptStringValue(std::to_string(get_value<ScriptNumberValue>(args[0])));
@@ -96,44 +150,61 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
     }}},
 
     {"exec",{-1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-        cc_builtin_if_ignore();
         if(args.size() < 2) {
             _cc_error("requires at least two arguments");
         }
         cc_builtin_var_requires(args[0],ScriptStringValue);
-        std::string f;
-        std::ifstream ifile;
-        ifile.open(get_value<ScriptStringValue>(args[0]),std::ios::in);
-        while(ifile.good()) f += ifile.get();
-        if(!f.empty()) f.pop_back();
-        ifile.close();
+        std::filesystem::path file = get_value<ScriptStringValue>(args[0]);
+        std::error_code ec;
+        auto time = std::filesystem::last_write_time(file,ec);
+        if(ec) _cc_error("no such file: " + file.string());
+        std::string key = std::filesystem::absolute(file,ec).lexically_normal().string();
 
         std::string label = get_value<ScriptStringValue>(args[1]);
         auto args2 = args;
-        args2.erase(args.begin(),args.begin()+1);
-        args2.erase(args.begin(),args.begin()+1);
-
-        Interpreter interp;
-        interp.script_builtins = settings.interpreter.script_builtins;
-        interp.script_operators = settings.interpreter.script_operators;
-        interp.script_typechecks = settings.interpreter.script_typechecks;
-        interp.script_macros = settings.interpreter.script_macros;
-        interp.pre_process(f).on_error([&](Interpreter& i) {
-            settings.error_msg = i.error();
-        });
-        if(settings.error_msg != "") return script_null;
-        return interp.run(label,args2).on_error([&](Interpreter& i) {
+        args2.erase(args2.begin(),args2.begin()+2);
+
+        auto modules = settings.interpreter.modules;
+        auto found = modules->find(key);
+        if(found == modules->end() || found->second.time != time) {
+            std::ifstream ifile(file,std::ios::binary);
+            std::string f(std::istreambuf_iterator<char>(ifile),{});
+            ifile.close();
+
+            Interpreter interp{InterpreterState(settings.interpreter)};
+            interp.pre_process(f).on_error([&](Interpreter& i) {
+                settings.error_msg = i.error();
+            });
+            if(settings.error_msg != "") return script_null;
+            found = modules->insert_or_assign(key,ScriptModule{
+                time,
+                InterpreterState(interp),
+                interp.settings.labels,
+                interp.settings.constants
+            }).first;
+        }
+
+        Interpreter interp{found->second.state};
+        interp.modules = modules;
+        interp.output = settings.interpreter.output;
+        interp.budget = settings.interpreter.budget;
+        interp.profiler = settings.interpreter.profiler;
+        interp.settings.labels = found->second.labels;
+        interp.settings.constants = found->second.constants;
+        ScriptVariable ret = interp.run(label,args2).on_error([&](Interpreter& i) {
             settings.error_msg = i.error();
         }).get_value_or(script_null);
+        // exit stops the calling script as well
+        if(interp.exit_code) settings.interpreter.exit_code = interp.exit_code;
+        return ret;
     }}},
     {"exit",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-        cc_builtin_if_ignore();
         cc_builtin_var_requires(args[0],ScriptNumberValue);
-        std::exit((int)get_value<ScriptNumberValue>(args[0]));
+        settings.interpreter.exit_code = (int)get_value<ScriptNumberValue>(args[0]);
+        settings.exit = true;
         return script_null;
     }}},
     {"system",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-        cc_builtin_if_ignore();
         cc_builtin_var_requires(args[0],ScriptStringValue);
         system((get_value<ScriptStringValue>(args[0])).c_str());
         return script_null;
@@ -141,7 +212,6 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
 
     /*
     {"add",{2,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-        cc_builtin_if_ignore();
         cc_builtin_var_requires(args[0],ScriptNameValue);
         cc_builtin_var_requires(args[1],ScriptStringValue);
         std::string type = get_value<ScriptNameValue>(args[0]);
@@ -161,7 +231,6 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
         return script_null;
     }}},
     {"remove",{2,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-        cc_builtin_if_ignore();
         cc_builtin_var_requires(args[0],ScriptNameValue);
         cc_builtin_var_requires(args[1],ScriptStringValue);
         std::string type = get_value<ScriptNameValue>(args[0]);
@@ -192,7 +261,6 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
         return script_null;
     }}},
     {"exists",{2,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-        cc_builtin_if_ignore();
         cc_builtin_var_requires(args[0],ScriptNameValue);
         cc_builtin_var_requires(args[1],ScriptStringValue);
         std::string type = get_value<ScriptNameValue>(args[0]);
@@ -215,7 +283,6 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
         return script_false;
     }}},
     {"copy",{2,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-        cc_builtin_if_ignore();
         cc_builtin_var_requires(args[0],ScriptStringValue);
         cc_builtin_var_requires(args[1],ScriptStringValue);
         std::string path = get_value<ScriptStringValue>(args[0]);
@@ -239,7 +306,6 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
     */
 
     {"read",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-        cc_builtin_if_ignore();
         cc_builtin_var_requires(args[0],ScriptStringValue);
         std::string r;
         std::ifstream ifile;
@@ -250,7 +316,6 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
         return new ScriptStringValue{r};
     }}},
     {"write",{2,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-        cc_builtin_if_ignore();
         cc_builtin_var_requires(args[0],ScriptStringValue);
         cc_builtin_var_requires(args[1],ScriptStringValue);
         std::ofstream ofile;
@@ -262,7 +327,6 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
     }}},
     
     {"call",{-1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-        cc_builtin_if_ignore();
         if(args.size() == 0) {
             _cc_error("requires at least one argument");
         }
@@ -273,32 +337,36 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
             run_args.push_back(args[i]);
         }
         
-        if(settings.labels.count(get_value<ScriptNameValue>(args[0])) == 0) {
+        auto found = settings.labels.find(get_value<ScriptNameValue>(args[0]));
+        if(found == settings.labels.end()) {
             _cc_error("no such label " + get_value<ScriptNameValue>(args[0]));
         }
-        ScriptLabel label = settings.labels[get_value<ScriptNameValue>(args[0])];
+        const ScriptLabel& label = found->second;
         if(label.arglist.size() > run_args.size()) {
             _cc_error("too few arguments");
         }
         else if(label.arglist.size() < run_args.size()) {
             _cc_error("too many arguments");
         }
+        // labels and constants are lent to the callee instead of copied
         ScriptSettings tset(settings.interpreter);
-        tset.constants = settings.constants;
-        settings.error_msg = run_label(get_value<ScriptNameValue>(args[0]),settings.labels,tset,"",run_args);
+        tset.constants.swap(settings.constants);
+        tset.labels.swap(settings.labels);
+        std::string error = run_label(get_value<ScriptNameValue>(args[0]),tset.labels,tset,"",run_args);
+        tset.labels.swap(settings.labels);
+        tset.constants.swap(settings.constants);
+        settings.error_msg = error;
         if(settings.error_msg != "") settings.raw_error = true;
 
         return tset.return_value;
     }}},
     {"return",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-        cc_builtin_if_ignore();
         settings.return_value = args[0];
         settings.exit = true;
         return script_null;
     }}},
 
     {"strmod",{-1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-        cc_builtin_if_ignore();
         if(args.size() < 2) {
             _cc_error("requires at least two argument");
         }
@@ -317,7 +385,7 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
             int idx = get_value<ScriptNumberValue>(args[2]);
             if(str.empty()) _cc_error("string empty");
             if(idx >= str.size()) _cc_error("index overflow");
-            if(idx < 0) _cc_error("index undeflow");
+            if(idx < 0) _cc_error("index underflow");
 
             str.erase(str.begin()+idx);
             settings.variables[get_value<ScriptNameValue>(args[1])] = new ScriptStringValue(str);
@@ -329,7 +397,7 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
             int idx = get_value<ScriptNumberValue>(args[2]);
             if(str.empty()) _cc_error("string empty");
             if(idx >= str.size()) _cc_error("index overflow");
-            if(idx < 0) _cc_error("index undeflow");
+            if(idx < 0) _cc_error("index underflow");
 
             str = str.substr(0,idx-1) + get_value<ScriptStringValue>(args[3]) + str.substr(idx,str.size()-1);
             settings.variables[get_value<ScriptNameValue>(args[1])] = new ScriptStringValue(str);
@@ -341,7 +409,7 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
             int idx = get_value<ScriptNumberValue>(args[2]);
             if(str.empty()) _cc_error("string empty");
             if(idx >= str.size()) _cc_error("index overflow");
-            if(idx < 0) _cc_error("index undeflow");
+            if(idx < 0) _cc_error("index underflow");
             
             str = str.substr(0,idx) + get_value<ScriptStringValue>(args[3]) + str.substr(idx+1,str.size()-1);
             settings.variables[get_value<ScriptNameValue>(args[1])] = new ScriptStringValue(str);
@@ -363,7 +431,7 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
             if(str.empty()) _cc_error("string empty");
             int idx = get_value<ScriptNumberValue>(args[2]);
             if(idx >= str.size()) _cc_error("index overflow");
-            if(idx < 0) _cc_error("index undeflow");
+            if(idx < 0) _cc_error("index underflow");
 
             return new ScriptStringValue(std::string(1,str.at(idx)));
         }
@@ -375,9 +443,9 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
             int idx_from = get_value<ScriptNumberValue>(args[2]);
             int idx_to = get_value<ScriptNumberValue>(args[3]);
             if(idx_from >= str.size()) _cc_error("index overflow");
-            if(idx_from < 0) _cc_error("index undeflow");
+            if(idx_from < 0) _cc_error("index underflow");
             if(idx_to >= str.size()) _cc_error("index overflow");
-            if(idx_to < 0) _cc_error("index undeflow");
+            if(idx_to < 0) _cc_error("index underflow");
             if(idx_to < idx_from) {int t = idx_to; idx_to = idx_from; idx_from = t;}
 
             return new ScriptStringValue(str.substr(idx_to, idx_from - idx_to));
@@ -390,14 +458,94 @@ inline std::map<std::string,ScriptBuiltin> default_script_builtins = {
     }}},
 
     {"bake",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-        cc_builtin_if_ignore();
         cc_builtin_var_requires(args[0],ScriptStringValue);
         return bake_extension(get_value<ScriptStringValue>(args[0]),settings) ? script_true : script_false;
     }}},
     {"typeof",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-        cc_builtin_if_ignore();
         return new ScriptStringValue(args[0].get_type());
     }}},
+
+    {"size",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
+        cc_builtin_var_requires(args[0],ScriptListValue,ScriptMapValue,ScriptStringValue);
+        if(is_typeof<ScriptListValue>(args[0])) return new ScriptNumberValue(get_value<ScriptListValue>(args[0]).size());
+        if(is_typeof<ScriptMapValue>(args[0])) return new ScriptNumberValue(get_value<ScriptMapValue>(args[0]).size());
+        return new ScriptNumberValue(get_value<ScriptStringValue>(args[0]).size());
+    }}},
+    {"at",{2,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
+        cc_builtin_var_requires(args[0],ScriptListValue,ScriptMapValue,ScriptStringValue);
+        if(is_typeof<ScriptMapValue>(args[0])) {
+            cc_builtin_var_requires(args[1],ScriptStringValue);
+            const auto& map = get_value<ScriptMapValue>(args[0]);
+            auto found = map.find(get_value<ScriptStringValue>(args[1]));
+            if(found == map.end()) _cc_error("no such key: " + args[1].string());
+            return found->second;
+        }
+        cc_builtin_var_requires(args[1],ScriptNumberValue);
+        if(is_typeof<ScriptListValue>(args[0])) {
+            const auto& list = get_value<ScriptListValue>(args[0]);
+            if(!valid_index(args[1],list.size(),settings)) return script_null;
+            return list[(size_t)get_value<ScriptNumberValue>(args[1])];
+        }
+        std::string str = get_value<ScriptStringValue>(args[0]);
+        if(!valid_index(args[1],str.size(),settings)) return script_null;
+        return new ScriptStringValue(std::string(1,str[(size_t)get_value<ScriptNumberValue>(args[1])]));
+    }}},
+    {"has",{2,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
+        cc_builtin_var_requires(args[0],ScriptMapValue);
+        cc_builtin_var_requires(args[1],ScriptStringValue);
+        return get_value<ScriptMapValue>(args[0]).count(get_value<ScriptStringValue>(args[1])) != 0 ? script_true : script_false;
+    }}},
+    {"keys",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
+        cc_builtin_var_requires(args[0],ScriptMapValue);
+        ScriptListValue::storage keys;
+        for(auto& i : ((const ScriptMapValue*)args[0].value.get())->keys()) {
+            keys.push_back(new ScriptStringValue(i));
+        }
+        return new ScriptListValue(keys);
+    }}},
+    {"push",{2,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
+        cc_builtin_var_requires(args[0],ScriptNameValue);
+        ScriptListValue* list = variable_as<ScriptListValue>(args[0],settings);
+        if(list == nullptr) _cc_error("requires list variable");
+        list->edit().push_back(args[1]);
+        return script_null;
+    }}},
+    {"pop",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
+        cc_builtin_var_requires(args[0],ScriptNameValue);
+        ScriptListValue* list = variable_as<ScriptListValue>(args[0],settings);
+        if(list == nullptr) _cc_error("requires list variable");
+        if(list->get_value().empty()) _cc_error("list empty");
+        ScriptVariable ret = list->get_value().back();
+        list->edit().pop_back();
+        return ret;
+    }}},
+    {"put",{3,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
+        cc_builtin_var_requires(args[0],ScriptNameValue);
+        if(ScriptMapValue* map = variable_as<ScriptMapValue>(args[0],settings)) {
+            cc_builtin_var_requires(args[1],ScriptStringValue);
+            map->edit()[get_value<ScriptStringValue>(args[1])] = args[2];
+            return script_null;
+        }
+        ScriptListValue* list = variable_as<ScriptListValue>(args[0],settings);
+        if(list == nullptr) _cc_error("requires list or map variable");
+        cc_builtin_var_requires(args[1],ScriptNumberValue);
+        if(!valid_index(args[1],list->get_value().size(),settings)) return script_null;
+        list->edit()[(size_t)get_value<ScriptNumberValue>(args[1])] = args[2];
+        return script_null;
+    }}},
+    {"erase",{2,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
+        cc_builtin_var_requires(args[0],ScriptNameValue);
+        if(ScriptMapValue* map = variable_as<ScriptMapValue>(args[0],settings)) {
+            cc_builtin_var_requires(args[1],ScriptStringValue);
+            return map->edit().erase(get_value<ScriptStringValue>(args[1])) != 0 ? script_true : script_false;
+        }
+        ScriptListValue* list = variable_as<ScriptListValue>(args[0],settings);
+        if(list == nullptr) _cc_error("requires list or map variable");
+        cc_builtin_var_requires(args[1],ScriptNumberValue);
+        if(!valid_index(args[1],list->get_value().size(),settings)) return script_null;
+        list->edit().erase(list->edit().begin() + (size_t)get_value<ScriptNumberValue>(args[1]));
+        return script_true;
+    }}},
 };
 
 inline std::vector<ScriptTypeCheck> default_script_typechecks = {
@@ -435,6 +583,8 @@ inline std::vector<ScriptTypeCheck> default_script_typechecks = {
         }
         return new ScriptNameValue(src.src);
     },
+    parse_list_literal,
+    parse_map_literal,
 };
 
 inline std::map<std::string,std::vector<ScriptOperator>> default_script_operators = {
@@ -1,16 +1,25 @@
 #ifndef CARESCRIPT_DEFS_HPP
 #define CARESCRIPT_DEFS_HPP
 
+#include <atomic>
 #include <cmath>
+#include <cstdint>
 #include <fstream>
+#include <iostream>
 #include <string>
 #include <vector>
+#include <map>
+#include <memory>
 #include <stack>
 #include <unordered_map>
 #include <filesystem>
 #include <exception>
 #include <functional>
 #include <any>
+#include <optional>
+#include <chrono>
+#include <mutex>
+#include <algorithm>
 
 #include "../mods/kittenlexer.hpp"
 
@@ -55,6 +64,9 @@ struct ScriptVariable {
     std::string get_type() const {
         return value.get()->get_type();
     }
+    ScriptTypeId get_type_id() const {
+        return value.get()->get_type_id();
+    }
     std::string printable() const {
         return value.get()->to_printable();
     }
@@ -73,24 +85,28 @@ struct ScriptVariable {
 };
 
 
+// returns the type id of a subclass of ScriptValue
+template<ScriptValueType _Tval>
+inline ScriptTypeId type_id_of() {
+    static const ScriptTypeId id = _Tval().get_type_id();
+    return id;
+}
+
 // checks if a variable has a specific type
 template<ScriptValueType _Tval>
 inline bool is_typeof(const carescript::ScriptVariable& var) {
-    _Tval inst;
-    return var.get_type() == inst.get_type();
+    return var.get_type_id() == type_id_of<_Tval>();
 }
 
 // checks if two subclasses of ScriptValue are the same
 template<ScriptValueType _Tp1, ScriptValueType _Tp2>
 inline bool is_same_type() {
-    _Tp1 v1;
-    _Tp2 v2;
-    return v1->get_type() == v2->get_type();
+    return type_id_of<_Tp1>() == type_id_of<_Tp2>();
 }
 
 // checks if two ScriptVariable instances have the same type
 inline bool is_same_type(const ScriptVariable& v1,const ScriptVariable& v2) {
-    return v1.get_type() == v2.get_type();
+    return v1.get_type_id() == v2.get_type_id();
 }
 
 // checks if a variable is null
@@ -100,27 +116,210 @@ inline bool is_null(const ScriptVariable& v) {
 
 // returns the unwrapped type of a variable
 template<typename _Tp>
-inline auto get_value(const carescript::ScriptVariable& v) {
+inline decltype(auto) get_value(const carescript::ScriptVariable& v) {
     return ((const _Tp*)v.value.get())->get_value();
 }
 
+// list type implementation
+// copies share the elements until one of them gets modified,
+// so passing a list around or iterating it doesn't copy it
+struct ScriptListValue : public ScriptValue {
+    using storage = std::vector<ScriptVariable>;
+    const std::string get_type() const override { return "List"; }
+    ScriptTypeId get_type_id() const override { return script_list_type; }
+    std::shared_ptr<storage> list = std::make_shared<storage>();
+
+    bool operator==(const ScriptValue* val) const override {
+        if(val->get_type_id() != get_type_id()) return false;
+        const ScriptListValue* other = (const ScriptListValue*)val;
+        return other->list == list || *other->list == *list;
+    }
+
+    std::string to_printable() const override {
+        std::string str = "[";
+        for(size_t i = 0; i < list->size(); ++i) {
+            if(i != 0) str += ", ";
+            str += (*list)[i].string();
+        }
+        return str + "]";
+    }
+    std::string to_string() const override {
+        return to_printable();
+    }
+
+    const storage& get_value() const { return *list; }
+    storage& edit() {
+        if(list.use_count() > 1) list = std::make_shared<storage>(*list);
+        return *list;
+    }
+    ScriptValue* copy() const override { return new ScriptListValue(*this); }
+
+    ScriptListValue() {}
+    ScriptListValue(storage elements): list(std::make_shared<storage>(std::move(elements))) {}
+};
+
+// map type implementation, keys are strings
+// shares its entries between copies like ScriptListValue
+struct ScriptMapValue : public ScriptValue {
+    using storage = std::unordered_map<std::string,ScriptVariable>;
+    const std::string get_type() const override { return "Map"; }
+    ScriptTypeId get_type_id() const override { return script_map_type; }
+    std::shared_ptr<storage> map = std::make_shared<storage>();
+
+    bool operator==(const ScriptValue* val) const override {
+        if(val->get_type_id() != get_type_id()) return false;
+        const ScriptMapValue* other = (const ScriptMapValue*)val;
+        return other->map == map || *other->map == *map;
+    }
+
+    std::vector<std::string> keys() const {
+        std::vector<std::string> ret;
+        for(const auto& i : *map) ret.push_back(i.first);
+        std::sort(ret.begin(),ret.end());
+        return ret;
+    }
+
+    std::string to_printable() const override {
+        std::string str = "{";
+        bool first = true;
+        for(const auto& i : keys()) {
+            if(!first) str += ", ";
+            first = false;
+            str += "\"" + i + "\": " + map->at(i).string();
+        }
+        return str + "}";
+    }
+    std::string to_string() const override {
+        return to_printable();
+    }
+
+    const storage& get_value() const { return *map; }
+    storage& edit() {
+        if(map.use_count() > 1) map = std::make_shared<storage>(*map);
+        return *map;
+    }
+    ScriptValue* copy() const override { return new ScriptMapValue(*this); }
+
+    ScriptMapValue() {}
+    ScriptMapValue(storage entries): map(std::make_shared<storage>(std::move(entries))) {}
+};
+
+// iterator protocol used by foreach
+// builtins can return their own iterators to produce values lazily
+struct ScriptIterator {
+    // stores the next element in value, returns false once exhausted
+    virtual bool next(ScriptVariable& value) = 0;
+    virtual ~ScriptIterator() {}
+};
+
+// iterator type implementation, copies share the same position
+struct ScriptIteratorValue : public ScriptValue {
+    const std::string get_type() const override { return "Iterator"; }
+    ScriptTypeId get_type_id() const override { return script_iterator_type; }
+    std::shared_ptr<ScriptIterator> iterator;
+
+    bool operator==(const ScriptValue* val) const override {
+        if(val->get_type_id() != get_type_id()) return false;
+        return ((const ScriptIteratorValue*)val)->iterator == iterator;
+    }
+
+    std::string to_printable() const override {
+        return "<iterator>";
+    }
+    std::string to_string() const override {
+        return to_printable();
+    }
+
+    ScriptIterator* get_value() const { return iterator.get(); }
+    ScriptValue* copy() const override { return new ScriptIteratorValue(iterator); }
+
+    ScriptIteratorValue() {}
+    ScriptIteratorValue(std::shared_ptr<ScriptIterator> iterator): iterator(iterator) {}
+};
+
+// walks a list without copying it, changes made to the list
+// while iterating detach it and don't affect the iteration
+struct ScriptListIterator : public ScriptIterator {
+    std::shared_ptr<ScriptListValue::storage> list;
+    size_t index = 0;
+
+    bool next(ScriptVariable& value) override {
+        if(index >= list->size()) return false;
+        value = (*list)[index++];
+        return true;
+    }
+
+    ScriptListIterator(std::shared_ptr<ScriptListValue::storage> list): list(list) {}
+};
+
+// walks the keys of a map in sorted order
+struct ScriptMapIterator : public ScriptIterator {
+    std::vector<std::string> keys;
+    size_t index = 0;
+
+    bool next(ScriptVariable& value) override {
+        if(index >= keys.size()) return false;
+        from(value,new ScriptStringValue(keys[index++]));
+        return true;
+    }
+
+    ScriptMapIterator(const ScriptMapValue& map): keys(map.keys()) {}
+};
+
+// walks the characters of a string
+struct ScriptStringIterator : public ScriptIterator {
+    std::string str;
+    size_t index = 0;
+
+    bool next(ScriptVariable& value) override {
+        if(index >= str.size()) return false;
+        from(value,new ScriptStringValue(std::string(1,str[index++])));
+        return true;
+    }
+
+    ScriptStringIterator(std::string str): str(std::move(str)) {}
+};
+
+// returns an iterator over value, nullptr if it isn't iterable
+inline std::shared_ptr<ScriptIterator> make_iterator(const ScriptVariable& value) {
+    switch(value.get_type_id()) {
+    case script_list_type:
+        return std::make_shared<ScriptListIterator>(((const ScriptListValue*)value.value.get())->list);
+    case script_map_type:
+        return std::make_shared<ScriptMapIterator>(*(const ScriptMapValue*)value.value.get());
+    case script_string_type:
+        return std::make_shared<ScriptStringIterator>(get_value<ScriptStringValue>(value));
+    case script_iterator_type:
+        return ((const ScriptIteratorValue*)value.value.get())->iterator;
+    }
+    return nullptr;
+}
+
 const ScriptVariable script_null = new ScriptNullValue();
 const ScriptVariable script_true = new ScriptNumberValue(true);
 const ScriptVariable script_false = new ScriptNumberValue(false);
 
 struct Interpreter;
 struct ScriptLabel;
+
+// a pre processor instruction that changes the interpreter state,
+// kept so a cached script can replay it without parsing the source
+struct ScriptDirective {
+    std::string instruction;
+    KittenToken body;
+    int line = 0;
+};
+
 // general storage class for the current state of execution
 struct ScriptSettings {
     Interpreter& interpreter;
     int line = 0;
     bool exit = false;
-    std::stack<bool> should_run;
     std::map<std::string,ScriptVariable> variables;
     std::map<std::string,ScriptVariable> constants;
     std::map<std::string,ScriptLabel> labels;
+    std::vector<ScriptDirective> directives;
     std::filesystem::path parent_path;
-    int ignore_endifs = 0;
     ScriptVariable return_value = script_null;
 
     std::string error_msg;
@@ -150,10 +349,42 @@ struct ScriptBuiltin {
     ScriptVariable(*exec)(const ScriptArglist&,ScriptSettings&);
 };
 
+// identifies the content of a table: the storage it lives in and the
+// revision of that storage
+struct ScriptTableVersion {
+    const void* table = nullptr;
+    std::uint64_t revision = 0;
+
+    bool operator==(const ScriptTableVersion& other) const { return table == other.table && revision == other.revision; }
+    bool operator!=(const ScriptTableVersion& other) const { return !(*this == other); }
+};
+
+// one argument of a statement, lexed once when its label is compiled
+struct ScriptExpression {
+    std::string source;
+    lexed_kittens tokens;
+};
+
+// a single `function (arguments)` line of a label
+// for control flow statements `jump` is the index of the statement
+// execution continues at when the statement jumps
+struct ScriptStatement {
+    std::string function;
+    KittenToken arguments;
+    int line = 0;
+    size_t jump = 0;
+    // the arguments split into expressions with macros already
+    // replaced, prepared once when the label is compiled and again
+    // if the macros changed since (see statement_expressions)
+    mutable std::vector<ScriptExpression> expressions;
+    mutable ScriptTableVersion macros;
+};
+
 // storage class for a label
 struct ScriptLabel {
     std::vector<std::string> arglist;
     lexed_kittens lines;
+    std::vector<ScriptStatement> statements;
     int line = 0;
 };
 
@@ -166,26 +397,99 @@ extern std::unordered_map<std::string,std::string> default_script_macros;
 bool bake_extension(std::string name, ScriptSettings& settings);
 class Extension;
 bool bake_extension(Extension* extension, ScriptSettings& settings);
+struct ExtensionDescriptorV1;
+bool bake_extension(const ExtensionDescriptorV1* descriptor, ScriptSettings& settings);
 
 // runs a "main" function of a script
 std::string run_script(std::string source, ScriptSettings& settings);
 // runs a specific label with the given parameters
-std::string run_label(std::string label_name, std::map<std::string,ScriptLabel> labels, ScriptSettings& settings, std::filesystem::path parent_path , std::vector<ScriptVariable> args);
+std::string run_label(std::string label_name, const std::map<std::string,ScriptLabel>& labels, ScriptSettings& settings, std::filesystem::path parent_path , std::vector<ScriptVariable> args);
 
 // preprocesses the file into the interpreter
 std::map<std::string,ScriptLabel> pre_process(std::string source, ScriptSettings& settings);
+// splits the lines of a label into statements and resolves their jumps
+bool compile_label(std::string label_name, ScriptLabel& label, ScriptSettings& settings);
 std::vector<ScriptVariable> parse_argumentlist(std::string source, ScriptSettings& settings);
+// splits an argument list into its expressions and replaces macros
+std::vector<std::string> prepare_argumentlist(std::string source, ScriptSettings& settings);
+// lexes the prepared expressions, so they can be evaluated repeatedly
+std::vector<ScriptExpression> compile_expressions(const std::vector<std::string>& sources);
+std::vector<ScriptVariable> evaluate_arguments(const std::vector<ScriptExpression>& expressions, ScriptSettings& settings);
+// the prepared expressions of a statement, prepared again first if
+// macros were added since, e.g. by bake or a resolved extension
+const std::vector<ScriptExpression>& statement_expressions(const ScriptStatement& statement, ScriptSettings& settings);
 // evaluates an expression and returns the result
 ScriptVariable evaluate_expression(std::string source, ScriptSettings& settings);
+ScriptVariable evaluate_expression(const ScriptExpression& expression, ScriptSettings& settings);
 void parse_const_preprog(std::string source, ScriptSettings& settings);
+bool run_directive(const ScriptDirective& directive, ScriptSettings& settings);
+
+// source of table revisions, unique across all tables of the process
+inline std::uint64_t next_table_revision() {
+    static std::atomic<std::uint64_t> revision{0};
+    return ++revision;
+}
+
+// copy-on-write wrapper for the tables of an interpreter.
+// copies share the same storage until one of them gets modified,
+// so creating an interpreter from a baked state doesn't copy any table
+template<typename _Tp>
+class ScriptTable {
+    std::shared_ptr<_Tp> table;
+    // changes whenever the content may have changed, copies keep it
+    std::uint64_t rev = next_table_revision();
+public:
+    ScriptTable(): table(std::make_shared<_Tp>()) {}
+    ScriptTable(const _Tp& t): table(std::make_shared<_Tp>(t)) {}
+
+    ScriptTable& operator=(const _Tp& t) {
+        table = std::make_shared<_Tp>(t);
+        rev = next_table_revision();
+        return *this;
+    }
+
+    const _Tp& get() const { return *table; }
+    // detaches the table from its copies before handing it out
+    _Tp& edit() {
+        if(table.use_count() > 1) table = std::make_shared<_Tp>(*table);
+        rev = next_table_revision();
+        return *table;
+    }
+    std::uint64_t revision() const { return rev; }
+    ScriptTableVersion version() const { return {table.get(),rev}; }
+    operator const _Tp&() const { return *table; }
+
+    auto begin() const { return table->begin(); }
+    auto end() const { return table->end(); }
+    size_t size() const { return table->size(); }
+    bool empty() const { return table->empty(); }
+    template<typename _Key> auto find(const _Key& key) const { return table->find(key); }
+    template<typename _Key> size_t count(const _Key& key) const { return table->count(key); }
+    template<typename _Key> const auto& at(const _Key& key) const { return table->at(key); }
+
+    template<typename _Key> auto& operator[](const _Key& key) { return edit()[key]; }
+    template<typename _It> void insert(_It first, _It last) { edit().insert(first,last); }
+    template<typename _Val> void push_back(const _Val& val) { edit().push_back(val); }
+    void clear() { table = std::make_shared<_Tp>(); rev = next_table_revision(); }
+};
+
+using BuiltinTable = ScriptTable<std::map<std::string,ScriptBuiltin>>;
+using OperatorTable = ScriptTable<std::map<std::string,std::vector<ScriptOperator>>>;
+using TypeCheckTable = ScriptTable<std::vector<ScriptTypeCheck>>;
+using MacroTable = ScriptTable<std::unordered_map<std::string,std::string>>;
 
 class Interpreter;
+// asked for names that aren't builtins (yet), may add them to the
+// interpreter, returns true if it did
+using ScriptResolver = std::function<bool(const std::string&,Interpreter&)>;
+
 // storage class to temporarily store states of the interpreter
 struct InterpreterState {
-    std::map<std::string,ScriptBuiltin> script_builtins;
-    std::map<std::string,std::vector<ScriptOperator>> script_operators;
-    std::vector<ScriptTypeCheck> script_typechecks;
-    std::unordered_map<std::string,std::string> script_macros;
+    BuiltinTable script_builtins;
+    OperatorTable script_operators;
+    TypeCheckTable script_typechecks;
+    MacroTable script_macros;
+    ScriptResolver resolver;
 
     InterpreterState() {}
     InterpreterState(const Interpreter& interp) { save(interp); }
@@ -224,9 +528,9 @@ struct InterpreterState {
         return *this;
     }
     InterpreterState& add(const std::map<std::string,std::vector<ScriptOperator>>& a) {
-        for(auto& i : script_operators) {
-            for(auto j : a.at(i.first)) {
-                i.second.push_back(j);
+        for(auto& i : a) {
+            for(auto& j : i.second) {
+                script_operators[i.first].push_back(j);
             }
         }
         return *this;
@@ -260,6 +564,114 @@ public:
     Interpreter& chain() { return interpreter; }
 };
 
+// a script file loaded by `exec`, kept to skip reading and
+// pre processing the same file again
+struct ScriptModule {
+    std::filesystem::file_time_type time;
+    InterpreterState state;
+    std::map<std::string,ScriptLabel> labels;
+    std::map<std::string,ScriptVariable> constants;
+};
+using ScriptModuleCache = std::map<std::string,ScriptModule>;
+
+// limits for running untrusted scripts, a limit of 0 means unlimited
+struct ScriptBudget {
+    size_t max_instructions = 0;
+    size_t max_depth = 0;
+    std::chrono::steady_clock::time_point deadline = std::chrono::steady_clock::time_point::max();
+
+    size_t instructions = 0;
+    size_t depth = 0;
+
+    // counts a statement, returns an error message once a limit is exceeded
+    std::string charge() {
+        ++instructions;
+        if(max_instructions != 0 && instructions > max_instructions) 
+            return "instruction limit exceeded (" + std::to_string(max_instructions) + ")";
+        // reading the clock for every statement would cost more than the statement
+        if(instructions % 256 == 1 && std::chrono::steady_clock::now() > deadline)
+            return "time limit exceeded";
+        return "";
+    }
+};
+
+// collects timings of labels, builtins and argument evaluation
+// one profiler may be shared by interpreters running on several threads,
+// every thread keeps its own stack of open frames
+struct ScriptProfiler {
+    enum FrameKind {
+        LABEL,
+        BUILTIN,
+        EXPRESSION
+    };
+    struct Entry {
+        size_t calls = 0;
+        std::chrono::nanoseconds inclusive{0};
+        std::chrono::nanoseconds exclusive{0};
+    };
+
+    std::map<std::string,Entry> labels;
+    std::map<std::string,Entry> builtins;
+    Entry expressions;
+    // "main;helper;echoln" -> time spent in exactly this stack
+    std::map<std::string,std::chrono::nanoseconds> folded;
+
+    void enter(FrameKind kind, const std::string& name) {
+        frames().push_back({kind,name,std::chrono::steady_clock::now()});
+    }
+
+    void leave() {
+        auto& stack = frames();
+        if(stack.empty()) return;
+        auto elapsed = std::chrono::steady_clock::now() - stack.back().start;
+        _Frame frame = stack.back();
+        std::string path;
+        for(const auto& i : stack) path += (path.empty() ? "" : ";") + i.name;
+        stack.pop_back();
+
+        if(!stack.empty()) stack.back().children += elapsed;
+        // exclusive label time only leaves out nested labels, not builtins
+        for(auto i = stack.rbegin(); frame.kind == LABEL && i != stack.rend(); ++i) {
+            if(i->kind == LABEL) {
+                i->nested_labels += elapsed;
+                break;
+            }
+        }
+
+        std::lock_guard<std::mutex> lock(mutex);
+        Entry& entry = frame.kind == LABEL ? labels[frame.name]
+            : frame.kind == BUILTIN ? builtins[frame.name] : expressions;
+        ++entry.calls;
+        entry.inclusive += elapsed;
+        entry.exclusive += elapsed - (frame.kind == LABEL ? frame.nested_labels : frame.children);
+        folded[path] += elapsed - frame.children;
+    }
+
+    // enters a frame for the lifetime of the scope, does nothing without a profiler
+    struct Scope {
+        ScriptProfiler* profiler;
+        Scope(ScriptProfiler* profiler, FrameKind kind, const std::string& name): profiler(profiler) {
+            if(profiler) profiler->enter(kind,name);
+        }
+        ~Scope() { if(profiler) profiler->leave(); }
+        Scope(const Scope&) = delete;
+    };
+private:
+    struct _Frame {
+        FrameKind kind;
+        std::string name;
+        std::chrono::steady_clock::time_point start;
+        std::chrono::steady_clock::duration children{0};
+        std::chrono::steady_clock::duration nested_labels{0};
+    };
+    std::mutex mutex;
+
+    static std::vector<_Frame>& frames() {
+        thread_local std::vector<_Frame> stack;
+        return stack;
+    }
+};
+
 // wrapper and storage class for a simpler API usage
 class Interpreter {
     std::map<int,InterpreterState> states;
@@ -269,11 +681,34 @@ class Interpreter {
         if(settings.error_msg != "" && on_error_f) on_error_f(*this);
     }
 public:
-    std::map<std::string,ScriptBuiltin> script_builtins = default_script_builtins;
-    std::map<std::string,std::vector<ScriptOperator>> script_operators = default_script_operators;
-    std::vector<ScriptTypeCheck> script_typechecks = default_script_typechecks;
-    std::unordered_map<std::string,std::string> script_macros = default_script_macros;
+    BuiltinTable script_builtins = default_script_builtins;
+    OperatorTable script_operators = default_script_operators;
+    TypeCheckTable script_typechecks = default_script_typechecks;
+    MacroTable script_macros = default_script_macros;
+    // used for lazily loaded builtins, see has_builtin
+    ScriptResolver resolver;
     ScriptSettings settings = ScriptSettings(*this);
+    // shared with the interpreters created by `exec`
+    std::shared_ptr<ScriptModuleCache> modules = std::make_shared<ScriptModuleCache>();
+    // where echo and echoln write to
+    std::ostream* output = &std::cout;
+    // no limits if null, shared with the interpreters created by `exec`
+    std::shared_ptr<ScriptBudget> budget;
+    // no profiling if null, shared with the interpreters created by `exec`
+    std::shared_ptr<ScriptProfiler> profiler;
+    // set by the exit builtin, the script stopped and the program
+    // running it decides what to do with the status
+    std::optional<int> exit_code;
+
+    Interpreter() {}
+    // starts from the tables of an already baked state, the tables
+    // are shared with it until either side modifies them
+    Interpreter(const InterpreterState& state):
+        script_builtins(state.script_builtins),
+        script_operators(state.script_operators),
+        script_typechecks(state.script_typechecks),
+        script_macros(state.script_macros),
+        resolver(state.resolver) {}
     
     void save(int id) {
         states[id].save(*this);
@@ -306,6 +741,7 @@ public:
 
     InterpreterError run() {
         settings.return_value = script_null;
+        exit_code.reset();
         settings.line = 1;
         settings.error_msg = run_label("main",settings.labels,settings,"",{});
         settings.exit = false;
@@ -320,6 +756,7 @@ public:
     }
     InterpreterError run(std::string label, std::vector<ScriptVariable> args) {
         settings.return_value = script_null;
+        exit_code.reset();
         settings.line = 1;
         settings.exit = false;
         settings.error_msg = run_label(label,settings.labels,settings,"",args);
@@ -329,6 +766,7 @@ public:
 
     InterpreterError eval(std::string source) {
         settings.return_value = script_null;
+        exit_code.reset();
         settings.error_msg = run_script(source,settings);
         settings.exit = false;
         error_check();
@@ -370,9 +808,16 @@ public:
             settings.error_msg = "error while baking: <compiled>";
         return *this;
     }
+    InterpreterError bake(const ExtensionDescriptorV1* descriptor) {
+        if(!bake_extension(descriptor,settings)) 
+            settings.error_msg = "error while baking: <compiled>";
+        return *this;
+    }
 
-    bool has_builtin(std::string name) {
-        return script_builtins.find(name) != script_builtins.end();
+    // gives the resolver a chance to provide unknown builtins
+    bool has_builtin(const std::string& name) {
+        if(script_builtins.find(name) != script_builtins.end()) return true;
+        return resolver && resolver(name,*this) && script_builtins.find(name) != script_builtins.end();
     }
     ScriptBuiltin& get_builtin(std::string name) {
         return script_builtins[name];
@@ -412,12 +857,14 @@ inline void InterpreterState::load(Interpreter& interp) const {
     interp.script_operators = this->script_operators;
     interp.script_typechecks = this->script_typechecks;
     interp.script_macros = this->script_macros;
+    interp.resolver = this->resolver;
 }
 inline void InterpreterState::save(const Interpreter& interp) {
     script_builtins = interp.script_builtins;
     script_operators = interp.script_operators;
     script_typechecks = interp.script_typechecks;
     script_macros = interp.script_macros;
+    resolver = interp.resolver;
 }
 
 // converts a literal into a variable
@@ -472,6 +919,111 @@ public:
 
 using get_extension_fun = Extension*(*)();
 
+// versioned extension interface
+// instead of a class, an extension exports `carescript_extension_v1`
+// returning a static descriptor. The descriptor only holds plain arrays,
+// which are registered without building any intermediate containers.
+// `size` is sizeof(ExtensionDescriptorV1) as the extension was compiled,
+// so later versions can append fields without breaking old extensions.
+// This is not a C ABI: the callbacks take carescript's C++ types, so an
+// extension also exports the layout it was compiled against (see
+// extension_layout) and is only loaded if that matches the interpreter's
+#define CARESCRIPT_EXTENSION_ABI_VERSION 1
+#define CARESCRIPT_EXTENSION_ENTRY_V1 "carescript_extension_v1"
+#define CARESCRIPT_EXTENSION_LAYOUT_V1 "carescript_extension_layout_v1"
+// bump when a type passed to extensions changes without changing its size
+#define CARESCRIPT_EXTENSION_LAYOUT_VERSION 1
+
+enum ExtensionCapability : std::uint32_t {
+    CARESCRIPT_HAS_BUILTINS = 1 << 0,
+    CARESCRIPT_HAS_OPERATORS = 1 << 1,
+    CARESCRIPT_HAS_MACROS = 1 << 2,
+    CARESCRIPT_HAS_TYPES = 1 << 3,
+};
+
+struct BuiltinDescriptorV1 {
+    const char* name;
+    int arg_count;
+    ScriptVariable(*exec)(const ScriptArglist&,ScriptSettings&);
+};
+struct OperatorDescriptorV1 {
+    const char* name;
+    int priority;
+    // 0 = unary, 1 = binary
+    int type;
+    ScriptVariable(*run)(ScriptVariable left, ScriptVariable right, ScriptSettings& settings);
+};
+struct MacroDescriptorV1 {
+    const char* name;
+    const char* replacement;
+};
+
+struct ExtensionDescriptorV1 {
+    std::uint32_t abi_version;
+    std::uint32_t size;
+    // ExtensionCapability flags, arrays without their flag are ignored
+    std::uint32_t capabilities;
+
+    const BuiltinDescriptorV1* builtins;
+    std::size_t builtin_count;
+    const OperatorDescriptorV1* operators;
+    std::size_t operator_count;
+    const MacroDescriptorV1* macros;
+    std::size_t macro_count;
+    const ScriptTypeCheck* types;
+    std::size_t type_count;
+};
+
+// identifies the C++ layout the descriptor callbacks rely on: the standard
+// library, its string ABI and the size of every type they pass around
+inline constexpr std::uint64_t extension_layout() {
+    const std::uint64_t parts[] = {
+        CARESCRIPT_EXTENSION_ABI_VERSION,
+        CARESCRIPT_EXTENSION_LAYOUT_VERSION,
+#if defined(_LIBCPP_VERSION)
+        1, _LIBCPP_ABI_VERSION,
+#elif defined(__GLIBCXX__)
+        2, _GLIBCXX_USE_CXX11_ABI,
+#elif defined(_MSC_VER)
+        3, _MSC_VER / 100,
+#else
+        0, 0,
+#endif
+        sizeof(void*),
+        sizeof(std::string),
+        sizeof(ScriptValue),
+        sizeof(ScriptVariable),
+        sizeof(ScriptArglist),
+        sizeof(ScriptSettings),
+        sizeof(Interpreter),
+        sizeof(KittenToken),
+    };
+    // FNV-1a over the parts
+    std::uint64_t hash = 14695981039346656037ull;
+    for(std::uint64_t i : parts) {
+        hash ^= i;
+        hash *= 1099511628211ull;
+    }
+    return hash;
+}
+
+using extension_entry_v1_fun = const ExtensionDescriptorV1*(*)();
+using extension_layout_v1_fun = std::uint64_t(*)();
+
+// defines the entry point of a versioned extension, together with the
+// layout it was compiled against
+#define CARESCRIPT_EXTENSION_V1(descriptor) extern "C" { \
+    const carescript::ExtensionDescriptorV1* carescript_extension_v1() { return &(descriptor); } \
+    std::uint64_t carescript_extension_layout_v1() { return carescript::extension_layout(); } }
+
+// a loaded extension, using the versioned interface if it provides it
+struct ExtensionHandle {
+    const ExtensionDescriptorV1* descriptor = nullptr;
+    Extension* legacy = nullptr;
+
+    operator bool() const { return descriptor != nullptr || legacy != nullptr; }
+};
+
 // external overloads for the ScriptVariable constructor
 
 template<typename _Tp>
@@ -7,6 +7,7 @@
 #include <string.h>
 #include <filesystem>
 #include <variant>
+#include <mutex>
 
 // Implementation for the functions declared in "carescript-defs.hpp"
 
@@ -18,25 +19,95 @@
 #ifdef _WIN32
 # include <windows.h>
 namespace carescript {
-inline static Extension* get_ext(std::filesystem::path name) { return nullptr; }
+inline static ExtensionHandle get_ext(std::filesystem::path name) { return {}; }
 #elif defined(__linux__)
 # include <dlfcn.h>
 namespace carescript {
-inline static Extension* get_ext(std::filesystem::path name) {
+// checks that a descriptor was made for an ABI this interpreter understands
+inline static bool valid_descriptor(const ExtensionDescriptorV1* descriptor) {
+    return descriptor != nullptr &&
+        descriptor->abi_version == CARESCRIPT_EXTENSION_ABI_VERSION &&
+        descriptor->size >= sizeof(ExtensionDescriptorV1);
+}
+
+// guards the libraries opened by get_ext, taken by processes forking
+// with threads alive, so the child doesn't inherit it locked
+inline std::mutex extension_mutex;
+
+inline static ExtensionHandle get_ext(std::filesystem::path name) {
+    // every library is only opened once per process
+    static std::map<std::string,ExtensionHandle> loaded;
     if(!name.has_extension()) name += ".so";
     if(name.is_relative())
         name = "./" + name.string();
+    std::lock_guard<std::mutex> lock(extension_mutex);
+    auto found = loaded.find(name.string());
+    if(found != loaded.end()) return found->second;
     void* handler = dlopen(name.c_str(),RTLD_NOW);
-    if(handler == nullptr) return nullptr;
-    get_extension_fun f = (get_extension_fun)dlsym(handler,"get_extension");
-    if(f == nullptr) return nullptr;
-    return f();
+    if(handler == nullptr) return {};
+
+    ExtensionHandle handle;
+    // the versioned entry point is preferred, get_extension is the fallback
+    // for extensions built against older versions
+    auto entry = (extension_entry_v1_fun)dlsym(handler,CARESCRIPT_EXTENSION_ENTRY_V1);
+    if(entry != nullptr) {
+        // the callbacks exchange C++ objects, so an extension built against
+        // another layout can't be called at all
+        auto layout = (extension_layout_v1_fun)dlsym(handler,CARESCRIPT_EXTENSION_LAYOUT_V1);
+        if(layout != nullptr && layout() == extension_layout()) {
+            handle.descriptor = entry();
+            if(!valid_descriptor(handle.descriptor)) handle.descriptor = nullptr;
+        }
+    }
+    else {
+        get_extension_fun f = (get_extension_fun)dlsym(handler,"get_extension");
+        if(f != nullptr) handle.legacy = f();
+    }
+    // unusable libraries are remembered as well, so they are only tried once
+    if(!handle.descriptor && !handle.legacy) dlclose(handler);
+    return loaded[name.string()] = handle;
 }
 #endif
 
 inline bool bake_extension(std::string name, ScriptSettings& settings) {
-    Extension* ext = get_ext(name);
-    return bake_extension(ext,settings);
+    ExtensionHandle ext = get_ext(name);
+    if(ext.descriptor) return bake_extension(ext.descriptor,settings);
+    return bake_extension(ext.legacy,settings);
+}
+
+inline bool bake_extension(const ExtensionDescriptorV1* descriptor, ScriptSettings& settings) {
+    if(descriptor == nullptr) return false;
+    Interpreter& interp = settings.interpreter;
+    std::uint32_t capabilities = descriptor->capabilities;
+
+    if(capabilities & CARESCRIPT_HAS_BUILTINS) {
+        auto& builtins = interp.script_builtins.edit();
+        for(std::size_t i = 0; i < descriptor->builtin_count; ++i) {
+            const BuiltinDescriptorV1& b = descriptor->builtins[i];
+            builtins.insert({b.name,ScriptBuiltin{b.arg_count,b.exec}});
+        }
+    }
+    if(capabilities & CARESCRIPT_HAS_OPERATORS) {
+        auto& operators = interp.script_operators.edit();
+        for(std::size_t i = 0; i < descriptor->operator_count; ++i) {
+            const OperatorDescriptorV1& o = descriptor->operators[i];
+            ScriptOperator op;
+            op.priority = o.priority;
+            op.type = o.type == 0 ? ScriptOperator::UNARY : ScriptOperator::BINARY;
+            op.run = o.run;
+            operators[o.name].push_back(op);
+        }
+    }
+    if(capabilities & CARESCRIPT_HAS_MACROS) {
+        auto& macros = interp.script_macros.edit();
+        for(std::size_t i = 0; i < descriptor->macro_count; ++i)
+            macros.insert({descriptor->macros[i].name,descriptor->macros[i].replacement});
+    }
+    if(capabilities & CARESCRIPT_HAS_TYPES) {
+        auto& types = interp.script_typechecks.edit();
+        types.insert(types.end(),descriptor->types,descriptor->types + descriptor->type_count);
+    }
+    return true;
 }
 
 inline bool bake_extension(Extension* ext, ScriptSettings& settings) {
@@ -68,9 +139,7 @@ inline std::string run_script(std::string source,ScriptSettings& settings) {
     return ret;
 }
 
-inline std::string run_label(std::string label_name, std::map<std::string,ScriptLabel> labels, ScriptSettings& settings, std::filesystem::path parent_path, std::vector<ScriptVariable> args) {
-    if(labels.empty() || labels.count(label_name) == 0) return "";
-    ScriptLabel label = labels[label_name];
+inline bool compile_label(std::string label_name, ScriptLabel& label, ScriptSettings& settings) {
     std::vector<lexed_kittens> lines;
     int line = -1;
     for(auto i : label.lines) {
@@ -80,44 +149,220 @@ inline std::string run_label(std::string label_name, std::map<std::string,Script
         }
         lines.back().push_back(i);
     }
-    settings.label.push(label_name);
-    for(auto i : lines) 
+
+    label.statements.clear();
+    // indices of the if, else, while and foreach statements not closed yet
+    std::vector<size_t> open;
+    auto error = [&](int line, std::string msg) {
+        settings.error_msg = "line " + std::to_string(line) + ": " + msg + " (in label " + label_name + ")";
+        return false;
+    };
+    auto opened = [&](std::string function) {
+        return !open.empty() && label.statements[open.back()].function == function;
+    };
+    for(auto& i : lines) {
         if(i.size() != 2 || i[0].str || i[1].str || i[1].src.front() != '(') { 
-            settings.label.pop();
-            return "line " + std::to_string(i.front().line) + " is invalid (in label " + label_name + ")"; 
+            settings.error_msg = "line " + std::to_string(i.front().line) + " is invalid (in label " + label_name + ")"; 
+            return false;
+        }
+        size_t current = label.statements.size();
+        label.statements.push_back({i[0].src,i[1],int(i[0].line),0,{},{}});
+        ScriptStatement& statement = label.statements.back();
+        // macros are replaced once here, until the macros change
+        statement.expressions = compile_expressions(prepare_argumentlist(statement.arguments.src,settings));
+        statement.macros = settings.interpreter.script_macros.version();
+
+        if(statement.function == "if" || statement.function == "while" || statement.function == "foreach") {
+            open.push_back(current);
+        }
+        else if(statement.function == "else") {
+            if(!opened("if")) return error(statement.line,"else without if");
+            label.statements[open.back()].jump = current + 1;
+            open.back() = current;
+        }
+        else if(statement.function == "endif") {
+            if(!opened("if") && !opened("else")) return error(statement.line,"endif without if");
+            label.statements[open.back()].jump = current + 1;
+            open.pop_back();
+        }
+        else if(statement.function == "endwhile" || statement.function == "endforeach") {
+            std::string head = statement.function.substr(3);
+            if(!opened(head)) return error(statement.line,statement.function + " without " + head);
+            label.statements[open.back()].jump = current + 1;
+            statement.jump = open.back();
+            open.pop_back();
+        }
+        else if(statement.function == "break" || statement.function == "continue") {
+            auto loop = std::find_if(open.rbegin(),open.rend(),[&](size_t j) {
+                return label.statements[j].function == "while" || label.statements[j].function == "foreach";
+            });
+            if(loop == open.rend()) return error(statement.line,statement.function + " outside of a loop");
+            statement.jump = *loop;
+        }
+    }
+    if(!open.empty()) {
+        std::string head = label.statements[open.back()].function;
+        return error(label.statements[open.back()].line,"missing end" + (head == "else" ? "if" : head));
+    }
+    return true;
+}
+
+// a running foreach loop
+struct _ScriptLoop {
+    std::string variable;
+    std::shared_ptr<ScriptIterator> iterator;
+};
+
+// runs the control flow statement at settings.line, returns false if
+// the statement is a plain function call
+// settings.line is one based, so jumping to statement i means settings.line = i+1
+inline static bool run_control_flow(const ScriptLabel& label, std::vector<_ScriptLoop>& loops, ScriptSettings& settings) {
+    const ScriptStatement& statement = label.statements[settings.line-1];
+    const std::string& name = statement.function;
+
+    // evaluates the condition of an if, while or foreach
+    auto condition = [&]() {
+        ScriptProfiler::Scope profile_condition(settings.interpreter.profiler.get(),ScriptProfiler::EXPRESSION,"(arguments)");
+        return evaluate_arguments(statement_expressions(statement,settings),settings);
+    };
+
+    // moves the innermost foreach loop to its next item or behind its end
+    auto next_item = [&](size_t head) {
+        ScriptVariable item;
+        if(loops.back().iterator->next(item)) {
+            settings.variables[loops.back().variable] = item;
+            settings.line = head + 2;
+        }
+        else {
+            loops.pop_back();
+            settings.line = label.statements[head].jump + 1;
         }
+    };
+
+    if(name == "else" || name == "endwhile") {
+        settings.line = statement.jump + 1;
+    }
+    else if(name == "endif") {
+        ++settings.line;
+    }
+    else if(name == "endforeach") {
+        next_item(statement.jump);
+    }
+    else if(name == "break") {
+        const ScriptStatement& head = label.statements[statement.jump];
+        if(head.function == "foreach") loops.pop_back();
+        settings.line = head.jump + 1;
+    }
+    else if(name == "continue") {
+        settings.line = label.statements[statement.jump].jump;
+    }
+    else if(name == "if" || name == "while") {
+        auto arglist = condition();
+        if(settings.error_msg != "") return true;
+        if(arglist.size() != 1 || !is_typeof<ScriptNumberValue>(arglist[0])) {
+            settings.error_msg = name + ": requires a single Number";
+            return true;
+        }
+        settings.line = get_value<ScriptNumberValue>(arglist[0]) == true ? settings.line + 1 : statement.jump + 1;
+    }
+    else if(name == "foreach") {
+        auto arglist = condition();
+        if(settings.error_msg != "") return true;
+        if(arglist.size() != 2 || !is_typeof<ScriptNameValue>(arglist[0])) {
+            settings.error_msg = "foreach: requires a variable name and a value";
+            return true;
+        }
+        std::shared_ptr<ScriptIterator> iterator = make_iterator(arglist[1]);
+        if(iterator == nullptr) {
+            settings.error_msg = "foreach: can't iterate over " + arglist[1].get_type();
+            return true;
+        }
+        loops.push_back({get_value<ScriptNameValue>(arglist[0]),iterator});
+        next_item(settings.line-1);
+    }
+    else return false;
+    return true;
+}
+
+inline std::string run_label(std::string label_name, const std::map<std::string,ScriptLabel>& labels, ScriptSettings& settings, std::filesystem::path parent_path, std::vector<ScriptVariable> args) {
+    auto found = labels.find(label_name);
+    if(found == labels.end()) return "";
+    const ScriptLabel& label = found->second;
+
+    std::shared_ptr<ScriptBudget> budget = settings.interpreter.budget;
+    if(budget) {
+        if(budget->max_depth != 0 && budget->depth >= budget->max_depth)
+            return "call depth limit exceeded (" + std::to_string(budget->max_depth) + ") (in label " + label_name + ")";
+        ++budget->depth;
+    }
+    struct _DepthGuard {
+        ScriptBudget* budget;
+        ~_DepthGuard() { if(budget) --budget->depth; }
+    } depth_guard{budget.get()};
+    ScriptProfiler* profiler = settings.interpreter.profiler.get();
+    ScriptProfiler::Scope profile_label(profiler,ScriptProfiler::LABEL,label_name);
+
+    settings.label.push(label_name);
 
     settings.parent_path = parent_path;
-    settings.labels = labels;
+    if(&settings.labels != &labels) settings.labels = labels;
 
     for(size_t i = 0; i < args.size(); ++i) {
         settings.variables[label.arglist[i]] = args[i];
     }
+    std::vector<_ScriptLoop> loops;
     if(settings.line == 0) settings.line = 1;
-    for(size_t i = settings.line-1; i < lines.size(); ++i) {
-        if(settings.exit) return "";
-        i = settings.line-1;
-        std::string name = lines[i][0].src;
-        auto arglist = parse_argumentlist(lines[i][1].src,settings);
+    while((size_t)settings.line <= label.statements.size()) {
+        if(settings.exit || settings.interpreter.exit_code) return "";
+        const ScriptStatement& statement = label.statements[settings.line-1];
+        const std::string& name = statement.function;
+
+        if(budget) {
+            std::string error = budget->charge();
+            if(error != "") {
+                settings.label.pop();
+                return "line " + std::to_string(statement.line) + ": " + error + " (in label " + label_name + ")";
+            }
+        }
+
+        // control flow is resolved by compile_label, branches that aren't
+        // taken are skipped without evaluating any of their lines
+        if(run_control_flow(label,loops,settings)) {
+            if(settings.error_msg != "") {
+                settings.label.pop();
+                if(settings.raw_error) return settings.error_msg;
+                return "line " + std::to_string(statement.line) + ": " + settings.error_msg + " (in label " + label_name + ")";
+            }
+            continue;
+        }
+
+        std::vector<ScriptVariable> arglist;
+        {
+            ScriptProfiler::Scope profile_arguments(profiler,ScriptProfiler::EXPRESSION,"(arguments)");
+            arglist = evaluate_arguments(statement_expressions(statement,settings),settings);
+        }
         if(settings.error_msg != "") {
             settings.label.pop();
             if(settings.raw_error) return settings.error_msg;
-            return "line " + std::to_string(settings.line + label.line) + ": " + settings.error_msg + " (in label " + label_name + ")";
+            return "line " + std::to_string(statement.line) + ": " + settings.error_msg + " (in label " + label_name + ")";
         }
-        if(settings.interpreter.script_builtins.count(name) == 0) {
+        if(!settings.interpreter.has_builtin(name)) {
             settings.label.pop();
-            return "line " + std::to_string(settings.line + label.line) + ": unknown function: " + name + " (in label " + label_name + ")";
+            return "line " + std::to_string(statement.line) + ": unknown function: " + name + " (in label " + label_name + ")";
         }
-        ScriptBuiltin builtin = settings.interpreter.script_builtins[name];
+        const ScriptBuiltin& builtin = settings.interpreter.script_builtins.at(name);
         if(builtin.arg_count != arglist.size() && builtin.arg_count >= 0) {
             settings.label.pop();
-            return "line " + std::to_string(lines[i][0].line + label.line) + " " + name + " has invalid argument count " + " (in label " + label_name + ")";
+            return "line " + std::to_string(statement.line) + ": " + name + " has invalid argument count (in label " + label_name + ")";
+        }
+        {
+            ScriptProfiler::Scope profile_builtin(profiler,ScriptProfiler::BUILTIN,name);
+            builtin.exec(arglist,settings);
         }
-        builtin.exec(arglist,settings);
         if(settings.error_msg != "") {
             settings.label.pop();
             if(settings.raw_error) return settings.error_msg;
-            return "line " + std::to_string(settings.line + label.line) + ": " + name + ": " + settings.error_msg + " (in label " + label_name + ")";
+            return "line " + std::to_string(statement.line) + ": " + name + ": " + settings.error_msg + " (in label " + label_name + ")";
         }
         ++settings.line;
     }
@@ -211,7 +456,7 @@ inline static std::vector<std::string> parse_label_arglist(std::string s) {
     return ret;
 }
 
-inline std::vector<ScriptVariable> parse_argumentlist(std::string source, ScriptSettings& settings) {
+inline std::vector<std::string> prepare_argumentlist(std::string source, ScriptSettings& settings) {
     KittenLexer arg_lexer = KittenLexer()
         .add_capsule('(',')')
         .add_capsule('[',']')
@@ -229,7 +474,7 @@ inline std::vector<ScriptVariable> parse_argumentlist(std::string source, Script
     source.pop_back();
 
     auto lexed = arg_lexer.lex(source);
-    if(lexed.empty()) return std::vector<ScriptVariable>{};
+    if(lexed.empty()) return {};
     std::vector<std::string> args(1);
     for(auto i : lexed) {
         if(!i.str && i.src == ",") {
@@ -242,15 +487,58 @@ inline std::vector<ScriptVariable> parse_argumentlist(std::string source, Script
             args.back() += " " + i.src;
         }
     }
+    return args;
+}
 
+inline lexed_kittens lex_expression(const std::string& source) {
+    return KittenLexer()
+        .add_stringq('"')
+        .add_capsule('(',')')
+        .add_capsule('[',']')
+        .add_capsule('{','}')
+        .add_con_extract(is_operator_char)
+        .add_ignore(' ')
+        .add_ignore('\t')
+        .add_backslashopt('t','\t')
+        .add_backslashopt('n','\n')
+        .add_backslashopt('r','\r')
+        .add_backslashopt('\\','\\')
+        .add_backslashopt('"','\"')
+        .erase_empty()
+        .lex(source);
+}
+
+inline std::vector<ScriptExpression> compile_expressions(const std::vector<std::string>& sources) {
+    std::vector<ScriptExpression> ret;
+    ret.reserve(sources.size());
+    for(const auto& i : sources) ret.push_back({i,lex_expression(i)});
+    return ret;
+}
+
+inline std::vector<ScriptVariable> evaluate_arguments(const std::vector<ScriptExpression>& expressions, ScriptSettings& settings) {
     std::vector<ScriptVariable> ret;
-    for(auto i : args) {
+    ret.reserve(expressions.size());
+    for(const auto& i : expressions) {
         ret.push_back(evaluate_expression(i,settings));
         if(settings.error_msg != "") return {};
     }
     return ret;
 }
 
+inline const std::vector<ScriptExpression>& statement_expressions(const ScriptStatement& statement, ScriptSettings& settings) {
+    // another interpreter may run the same labels with other macros
+    ScriptTableVersion macros = settings.interpreter.script_macros.version();
+    if(statement.macros != macros) {
+        statement.expressions = compile_expressions(prepare_argumentlist(statement.arguments.src,settings));
+        statement.macros = macros;
+    }
+    return statement.expressions;
+}
+
+inline std::vector<ScriptVariable> parse_argumentlist(std::string source, ScriptSettings& settings) {
+    return evaluate_arguments(compile_expressions(prepare_argumentlist(source,settings)),settings);
+}
+
 inline static bool is_operator(std::string src, ScriptSettings& settings) {
     return settings.interpreter.script_operators.count(src) != 0;
 }
@@ -305,7 +593,7 @@ struct _ExpressionFuncall {
 
     ScriptVariable call(ScriptSettings& settings, _ExpressionErrors& errors) {
         ScriptArglist args = parse_argumentlist(arguments,settings);
-        ScriptBuiltin fun = settings.interpreter.get_builtin(function);
+        ScriptBuiltin fun = settings.interpreter.script_builtins.at(function);
         if(settings.error_msg != "") {
             errors.push("error parsing argumentlist: " + settings.error_msg);
             settings.error_msg = "";
@@ -324,6 +612,7 @@ struct _ExpressionFuncall {
             }
         }
         settings.error_msg = "";
+        ScriptProfiler::Scope profile_builtin(settings.interpreter.profiler.get(),ScriptProfiler::BUILTIN,function);
         ScriptVariable ret =  fun.exec(args,settings);
         if(settings.error_msg != "") errors.push(settings.error_msg);
         return ret;
@@ -366,7 +655,7 @@ struct _OperatorToken {
     }
 };
 
-inline std::vector<_OperatorToken> expression_prepare_tokens(lexed_kittens& tokens, ScriptSettings& settings, _ExpressionErrors& errors) {
+inline std::vector<_OperatorToken> expression_prepare_tokens(const lexed_kittens& tokens, ScriptSettings& settings, _ExpressionErrors& errors) {
     std::vector<_OperatorToken> ret;
     for(size_t i = 0; i < tokens.size(); ++i) {
         auto token = tokens[i];
@@ -378,7 +667,6 @@ inline std::vector<_OperatorToken> expression_prepare_tokens(lexed_kittens& toke
             ret.push_back(token.src);
         }
         else if(!token.str && settings.interpreter.has_builtin(token.src)) {
-            ScriptBuiltin builtin = settings.interpreter.get_builtin(token.src);
             if(i + 1 >= tokens.size() || tokens[i+1].str) {
                 errors.push("function call without argument list");
                 return {};
@@ -394,7 +682,11 @@ inline std::vector<_OperatorToken> expression_prepare_tokens(lexed_kittens& toke
         }
         else {
             ret.push_back(to_var(token,settings));
-            if(is_null(ret.back().val)) {
+            if(settings.error_msg != "") {
+                errors.push(settings.error_msg);
+                settings.error_msg = "";
+            }
+            else if(is_null(ret.back().val)) {
                 if(token.str) token.src = "\"" + token.src + "\"";
                 errors.push("invalid literal: " + token.src);
             }
@@ -489,7 +781,9 @@ inline ScriptVariable expression_force_parse(std::vector<_OperatorToken> markedu
         markedupTokens[i].op.op.type = ScriptOperator::BINARY;
     }
 
-    for(auto option : settings.interpreter.script_operators[markedupTokens[i].op.tk]) {
+    auto options = settings.interpreter.script_operators.find(markedupTokens[i].op.tk);
+    if(options == settings.interpreter.script_operators.end()) return script_null;
+    for(auto option : options->second) {
         auto op = markedupTokens[i].op.op;
         if(option.type != op.type)
             continue;
@@ -506,27 +800,16 @@ inline ScriptVariable expression_force_parse(std::vector<_OperatorToken> markedu
 }
 
 inline ScriptVariable evaluate_expression(std::string source, ScriptSettings& settings) {
-    KittenLexer expression_lexer = KittenLexer()
-        .add_stringq('"')
-        .add_capsule('(',')')
-        .add_capsule('[',']')
-        .add_capsule('{','}')
-        .add_con_extract(is_operator_char)
-        .add_ignore(' ')
-        .add_ignore('\t')
-        .add_backslashopt('t','\t')
-        .add_backslashopt('n','\n')
-        .add_backslashopt('r','\r')
-        .add_backslashopt('\\','\\')
-        .add_backslashopt('"','\"')
-        .erase_empty();
-    auto lexed = expression_lexer.lex(source);
+    return evaluate_expression(ScriptExpression{source,lex_expression(source)},settings);
+}
+
+inline ScriptVariable evaluate_expression(const ScriptExpression& expression, ScriptSettings& settings) {
     _ExpressionErrors errors;
 
-    auto result = expression_force_parse(expression_prepare_tokens(lexed,settings,errors),settings,errors);
+    auto result = expression_force_parse(expression_prepare_tokens(expression.tokens,settings,errors),settings,errors);
 
     if(errors.changed() || is_null(result)) {
-        settings.error_msg = "\nError in expression: " + source + "\n";
+        settings.error_msg = "\nError in expression: " + expression.source + "\n";
         for(auto i : errors.messages) {
             settings.error_msg += i + "\n";
         }
@@ -579,8 +862,72 @@ inline void parse_const_preprog(std::string source, ScriptSettings& settings) {
     }
 }
 
+// runs a pre processor instruction that changes the state of the
+// interpreter (@const, @bake), returns false and sets the error on failure
+inline bool run_directive(const ScriptDirective& directive, ScriptSettings& settings) {
+    if(directive.instruction == "const") {
+        auto body = directive.body.src;
+        if(directive.body.str) {
+            settings.error_msg = "line " + std::to_string(directive.line) + ": const: unexpected string";
+            return false;
+        }
+        if(body.size() < 2) {
+            settings.error_msg = "line " + std::to_string(directive.line) + ": const: unexpected token";
+            return false;
+        }
+        if(body.front() != '[' || body.back() != ']') {
+            settings.error_msg = "line " + std::to_string(directive.line) + ": const: expected body";
+            return false;
+        }
+        body.erase(body.begin());
+        body.erase(body.end()-1);
+        parse_const_preprog(body,settings);
+        if(settings.error_msg != "") {
+            settings.error_msg = "line " + std::to_string(directive.line) + ": const: line " + std::to_string(settings.line) + ": " + settings.error_msg;
+            return false;
+        }
+    }
+    else if(directive.instruction == "bake") {
+        KittenLexer bake_lexer = KittenLexer()
+            .add_stringq('"')
+            .erase_empty()
+            .add_ignore(' ')
+            .add_ignore('\t')
+            .add_ignore('\n')
+            ;
+        auto body = directive.body.src;
+        if(directive.body.str) {
+            settings.error_msg = "line " + std::to_string(directive.line) + ": bake: unexpected string";
+            return false;
+        }
+        if(body.size() < 2) {
+            settings.error_msg = "line " + std::to_string(directive.line) + ": bake: unexpected token";
+            return false;
+        }
+        if(body.front() != '[' || body.back() != ']') {
+            settings.error_msg = "line " + std::to_string(directive.line) + ": bake: expected body";
+            return false;
+        }
+        body.erase(body.begin());
+        body.erase(body.end()-1);
+        auto lexed = bake_lexer.lex(body);
+        for(auto b : lexed) {
+            if(!b.str) {
+                settings.error_msg = "line " + std::to_string(directive.line) + ": bake: expected value: " + b.src;
+                return false;
+            }
+            if(!bake_extension(b.src,settings)) {
+                settings.error_msg = "line " + std::to_string(directive.line) + ": bake: error baking extension: " + b.src + "\n" + dlerror(); 
+                return false;
+            }
+        }
+    }
+    return true;
+}
+
 inline std::map<std::string,ScriptLabel> pre_process(std::string source, ScriptSettings& settings) {
     std::map<std::string,ScriptLabel> ret;
+    settings.directives.clear();
     KittenLexer lexer = KittenLexer()
         .add_stringq('"')
         .add_capsule('(',')')
@@ -618,62 +965,10 @@ inline std::map<std::string,ScriptLabel> pre_process(std::string source, ScriptS
             }
             std::string inst = line[1].src;
 
-            if(inst == "const") {
-                auto body = line[2].src;
-                if(line[2].str) {
-                    settings.error_msg = "line " + std::to_string(i+1) + ": const: unexpected string";
-                    return {};
-                }
-                if(body.size() < 2) {
-                    settings.error_msg = "line " + std::to_string(i+1) + ": const: unexpected token";
-                    return {};
-                }
-                if(body.front() != '[' || body.back() != ']') {
-                    settings.error_msg = "line " + std::to_string(i+1) + ": const: expected body";
-                    return {};
-                }
-                body.erase(body.begin());
-                body.erase(body.end()-1);
-                parse_const_preprog(body,settings);
-                if(settings.error_msg != "") {
-                    settings.error_msg = "line " + std::to_string(i+1) + ": const: line " + std::to_string(settings.line) + ": " + settings.error_msg;
-                    return {};
-                }
-            }
-            else if(inst == "bake") {
-                KittenLexer bake_lexer = KittenLexer()
-                    .add_stringq('"')
-                    .erase_empty()
-                    .add_ignore(' ')
-                    .add_ignore('\t')
-                    .add_ignore('\n')
-                    ;
-                auto body = line[2].src;
-                if(line[2].str) {
-                    settings.error_msg = "line " + std::to_string(i+1) + ": bake: unexpected string";
-                    return {};
-                }
-                if(body.size() < 2) {
-                    settings.error_msg = "line " + std::to_string(i+1) + ": bake: unexpected token";
-                    return {};
-                }
-                if(body.front() != '[' || body.back() != ']') {
-                    settings.error_msg = "line " + std::to_string(i+1) + ": bake: expected body";
-                    return {};
-                }
-                body.erase(body.begin());
-                body.erase(body.end()-1);
-                auto lexed = bake_lexer.lex(body);
-                for(auto b : lexed) {
-                    if(!b.str) {
-                        settings.error_msg = "line " + std::to_string(i+1) + ": bake: expected value: " + b.src;
-                        return {};
-                    }
-                    if(!bake_extension(b.src,settings)) {
-                        settings.error_msg = "line " + std::to_string(i+1) + ": bake: error baking extension: " + b.src + "\n" + dlerror(); 
-                        return {};
-                    }
-                }
+            if(inst == "const" || inst == "bake") {
+                ScriptDirective directive{inst,line[2],int(i+1)};
+                if(!run_directive(directive,settings)) return {};
+                settings.directives.push_back(directive);
             }
             else if(is_label_arglist(line[2].src) && !line[2].str) {
                 if(ret.count(line[1].src) != 0) {
@@ -693,6 +988,9 @@ inline std::map<std::string,ScriptLabel> pre_process(std::string source, ScriptS
         }
     }
 
+    for(auto& i : ret) {
+        if(!compile_label(i.first,i.second,settings)) return {};
+    }
     return ret;
 }
 
@@ -1,15 +1,74 @@
 #ifndef CARESCRIPT_TYPES_HPP
 #define CARESCRIPT_TYPES_HPP
 
+#include <atomic>
 #include <string>
 #include <vector>
+#include <deque>
+#include <mutex>
+#include <unordered_map>
 
 namespace carescript {
 
+// small integer handle of a value type
+// type checks compare these, the names are only used for messages
+using ScriptTypeId = unsigned int;
+
+constexpr ScriptTypeId script_number_type = 0;
+constexpr ScriptTypeId script_string_type = 1;
+constexpr ScriptTypeId script_name_type = 2;
+constexpr ScriptTypeId script_null_type = 3;
+constexpr ScriptTypeId script_list_type = 4;
+constexpr ScriptTypeId script_map_type = 5;
+constexpr ScriptTypeId script_iterator_type = 6;
+
+namespace _type_registry {
+inline std::mutex mutex;
+inline std::deque<std::string> names = {"Number","String","Name","Null","List","Map","Iterator"};
+inline std::unordered_map<std::string,ScriptTypeId> ids = {
+    {"Number",script_number_type},
+    {"String",script_string_type},
+    {"Name",script_name_type},
+    {"Null",script_null_type},
+    {"List",script_list_type},
+    {"Map",script_map_type},
+    {"Iterator",script_iterator_type},
+};
+} /* namespace _type_registry */
+
+// returns the id of a type name, assigning a new one on first use
+inline ScriptTypeId register_type(const std::string& name) {
+    std::lock_guard<std::mutex> lock(_type_registry::mutex);
+    auto found = _type_registry::ids.find(name);
+    if(found != _type_registry::ids.end()) return found->second;
+    ScriptTypeId id = _type_registry::names.size();
+    _type_registry::names.push_back(name);
+    _type_registry::ids[name] = id;
+    return id;
+}
+
+// returns the name of a registered type id
+inline std::string type_name(ScriptTypeId id) {
+    std::lock_guard<std::mutex> lock(_type_registry::mutex);
+    if(id >= _type_registry::names.size()) return "";
+    return _type_registry::names[id];
+}
+
 // abstract class to provide an interface for all types
 struct ScriptValue {
     using type = void;
     virtual const std::string get_type() const = 0;
+    // types should override this with a cached id, e.g.:
+    // `static const ScriptTypeId id = register_type("MyType"); return id;`
+    // types that don't are looked up once per value
+    virtual ScriptTypeId get_type_id() const {
+        ScriptTypeId id = cached_type_id.load(std::memory_order_relaxed);
+        if(id == unknown_type_id) {
+            id = register_type(get_type());
+            cached_type_id.store(id,std::memory_order_relaxed);
+        }
+        return id;
+    }
     virtual bool operator==(const ScriptValue*) const = 0;
     virtual bool operator==(const ScriptValue&v) const { return operator==(&v); }
     virtual std::string to_printable() const = 0;
@@ -17,16 +76,24 @@ struct ScriptValue {
     virtual ScriptValue* copy() const = 0;
     void get_value() const {}
 
+    ScriptValue() {}
+    // the cached id belongs to the object, copies look theirs up again
+    ScriptValue(const ScriptValue&) {}
+    ScriptValue& operator=(const ScriptValue&) { return *this; }
     virtual ~ScriptValue() {};
+private:
+    static constexpr ScriptTypeId unknown_type_id = ~ScriptTypeId(0);
+    mutable std::atomic<ScriptTypeId> cached_type_id = unknown_type_id;
 };
 
 // default number type implementation
 struct ScriptNumberValue : public ScriptValue {
     const std::string get_type() const override { return "Number"; }
+    ScriptTypeId get_type_id() const override { return script_number_type; }
     long double number = 0.0;
 
     bool operator==(const ScriptValue* val) const override {
-        return val->get_type() == get_type() && ((ScriptNumberValue*)val)->number == number;
+        return val->get_type_id() == get_type_id() && ((ScriptNumberValue*)val)->number == number;
     }
 
     std::string to_printable() const override {
@@ -51,10 +118,11 @@ struct ScriptNumberValue : public ScriptValue {
 // default string type implementation
 struct ScriptStringValue : public ScriptValue {
     const std::string get_type() const override { return "String"; }
+    ScriptTypeId get_type_id() const override { return script_string_type; }
     std::string string = "";
     
     bool operator==(const ScriptValue* val) const override {
-        return val->get_type() == get_type() && ((ScriptStringValue*)val)->string == string;
+        return val->get_type_id() == get_type_id() && ((ScriptStringValue*)val)->string == string;
     }
 
     std::string to_printable() const override {
@@ -76,10 +144,11 @@ struct ScriptStringValue : public ScriptValue {
 // default name type implementation
 struct ScriptNameValue : public ScriptValue {
     const std::string get_type() const override { return "Name"; }
+    ScriptTypeId get_type_id() const override { return script_name_type; }
     std::string name = "";
     
     bool operator==(const ScriptValue* val) const override {
-        return val->get_type() == get_type() && ((ScriptNameValue*)val)->name == name;
+        return val->get_type_id() == get_type_id() && ((ScriptNameValue*)val)->name == name;
     }
 
     std::string to_printable() const override {
@@ -99,9 +168,10 @@ struct ScriptNameValue : public ScriptValue {
 // default null type implementation
 struct ScriptNullValue : public ScriptValue {
     const std::string get_type() const override { return "Null"; }
+    ScriptTypeId get_type_id() const override { return script_null_type; }
     
     bool operator==(const ScriptValue* val) const override {
-        return val->get_type() == get_type();
+        return val->get_type_id() == get_type_id();
     }
 
     std::string to_printable() const override {
@@ -0,0 +1,13 @@
+#ifndef ARCHIVE_HPP
+#define ARCHIVE_HPP
+
+#include <string>
+#include <map>
+
+// streams the .tar.gz at url and writes the listed members to their
+// destinations (path in the archive -> file), nothing else touches the disk
+// members may also sit below one top level directory, as in the branch
+// archives of forges. returns "" on success, else what went wrong
+std::string download_archive(std::string url, const std::map<std::string,std::string>& files);
+
+#endif
@@ -1,6 +1,130 @@
 #include "../carescript/carescript-api.hpp"
 #include "network.hpp"
 #include "configs.hpp"
+#include "fsops.hpp"
+#include "transfer.hpp"
+
+// converts an ini value into the matching carescript value
+inline carescript::ScriptVariable ini_to_script(IniElement element) {
+    using namespace carescript;
+    switch(element.get_type()) {
+    case IniType::List: {
+        ScriptListValue::storage list;
+        for(auto& i : element.to_list()) list.push_back(ini_to_script(i));
+        return new ScriptListValue(list);
+    }
+    case IniType::Dictionary: {
+        ScriptMapValue::storage map;
+        for(auto& i : element.to_dictionary()) map[i.first] = ini_to_script(i.second);
+        return new ScriptMapValue(map);
+    }
+    // scalars stay strings, as the checklist builtin always returned them
+    default:
+        return new ScriptStringValue((std::string)element);
+    }
+}
+
+// lists a directory lazily for foreach
+struct DirectoryIterator : public carescript::ScriptIterator {
+    std::filesystem::directory_iterator it;
+
+    bool next(carescript::ScriptVariable& value) override {
+        std::error_code ec;
+        if(it == std::filesystem::directory_iterator()) return false;
+        from(value,new carescript::ScriptStringValue(it->path().string()));
+        it.increment(ec);
+        if(ec) it = std::filesystem::directory_iterator();
+        return true;
+    }
+
+    DirectoryIterator(std::filesystem::directory_iterator it): it(it) {}
+};
+
+// handle of a download started with download_async
+struct ScriptTransferValue : public carescript::ScriptValue {
+    std::string url;
+    std::string file;
+    std::shared_future<bool> result;
+
+    const std::string get_type() const override { return "Transfer"; }
+    carescript::ScriptTypeId get_type_id() const override {
+        static const carescript::ScriptTypeId id = carescript::register_type("Transfer");
+        return id;
+    }
+    bool operator==(const carescript::ScriptValue* val) const override {
+        if(val->get_type_id() != get_type_id()) return false;
+        const ScriptTransferValue* other = (const ScriptTransferValue*)val;
+        return other->url == url && other->file == file;
+    }
+    std::string to_printable() const override {
+        return "<transfer " + url + ">";
+    }
+    std::string to_string() const override {
+        return to_printable();
+    }
+
+    bool get_value() const { return result.get(); }
+    carescript::ScriptValue* copy() const override { return new ScriptTransferValue(url,file,result); }
+
+    ScriptTransferValue() {}
+    ScriptTransferValue(std::string url, std::string file, std::shared_future<bool> result)
+        : url(url), file(file), result(result) {}
+};
+
+// yields the matches of a glob pattern while walking the file system
+struct GlobIterator : public carescript::ScriptIterator {
+    GlobWalker walker;
+
+    bool next(carescript::ScriptVariable& value) override {
+        std::filesystem::path path;
+        if(!walker.next(path)) return false;
+        from(value,new carescript::ScriptStringValue(path.string()));
+        return true;
+    }
+
+    GlobIterator(std::string pattern): walker(pattern) {}
+};
+
+// collects the paths of a list, an iterator or a single string
+inline bool script_to_paths(const carescript::ScriptVariable& value, std::vector<std::filesystem::path>& paths, carescript::ScriptSettings& settings) {
+    using namespace carescript;
+    if(is_typeof<ScriptStringValue>(value)) {
+        paths.push_back(get_value<ScriptStringValue>(value));
+        return true;
+    }
+    std::shared_ptr<ScriptIterator> it = make_iterator(value);
+    if(it == nullptr) {
+        settings.error_msg = "expected a path or a collection of paths (got: " + value.get_type() + ")";
+        return false;
+    }
+    ScriptVariable item;
+    while(it->next(item)) {
+        if(!is_typeof<ScriptStringValue>(item)) {
+            settings.error_msg = "expected paths (got: " + item.get_type() + ")";
+            return false;
+        }
+        paths.push_back(get_value<ScriptStringValue>(item));
+    }
+    return true;
+}
+
+// runs a bulk operation and returns the paths that failed as a list
+inline carescript::ScriptVariable script_bulk_operation(FileOperation op, const carescript::ScriptVariable& paths, std::string dest, carescript::ScriptSettings& settings) {
+    using namespace carescript;
+    std::vector<std::filesystem::path> list;
+    if(!script_to_paths(paths,list,settings)) return script_null;
+    std::error_code ec;
+    if(op != FileOperation::REMOVE && !std::filesystem::is_directory(dest,ec)) {
+        settings.error_msg = "no such directory: " + dest;
+        return script_null;
+    }
+
+    ScriptListValue::storage failed;
+    for(auto& i : bulk_file_operation(op,list,dest)) {
+        failed.push_back(new ScriptStringValue(i.first.string()));
+    }
+    return new ScriptListValue(failed);
+}
 
 class CCSExtension : public carescript::Extension {   
 public:
@@ -8,20 +132,41 @@ public:
         using namespace carescript;
         return {
             {"download",{2,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-                cc_builtin_if_ignore();
                 cc_builtin_var_requires(args[0],ScriptStringValue);
                 cc_builtin_var_requires(args[1],ScriptStringValue);
-                if(!download_page(
+                if(!transfer_engine().enqueue(
                     get_value<ScriptStringValue>(args[0]),
                     get_value<ScriptStringValue>(args[1])
-                )) {
+                ).get()) {
                     return script_false; /*="error while downloading from URL: " + get_value<ScriptStringValue>(args[0]); */
                 }
                 return script_true;
             }}},
+            {"download_async",{2,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
+                cc_builtin_var_requires(args[0],ScriptStringValue);
+                cc_builtin_var_requires(args[1],ScriptStringValue);
+                std::string url = get_value<ScriptStringValue>(args[0]);
+                std::string file = get_value<ScriptStringValue>(args[1]);
+                return new ScriptTransferValue(url,file,transfer_engine().enqueue(url,file));
+            }}},
+            {"await",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
+                cc_builtin_var_requires(args[0],ScriptTransferValue);
+                return get_value<ScriptTransferValue>(args[0]) ? script_true : script_false;
+            }}},
+            // waits for a list or iterator of transfers, true if all succeeded
+            {"await_all",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
+                std::shared_ptr<ScriptIterator> it = make_iterator(args[0]);
+                if(it == nullptr) _cc_error("expected a collection of transfers (got: " + args[0].get_type() + ")");
+                bool ok = true;
+                ScriptVariable item;
+                while(it->next(item)) {
+                    cc_builtin_var_requires(item,ScriptTransferValue);
+                    ok = get_value<ScriptTransferValue>(item) && ok;
+                }
+                return ok ? script_true : script_false;
+            }}},
             
             {"add_file",{2,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-                cc_builtin_if_ignore();
                 cc_builtin_var_requires(args[0],ScriptStringValue);
                 cc_builtin_var_requires(args[1],ScriptStringValue);
                 std::ofstream of(get_value<ScriptStringValue>(args[0]), std::ios::trunc);
@@ -32,56 +177,64 @@ public:
                 return script_null;
             }}},
             {"add_directory",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-                cc_builtin_if_ignore();
                 cc_builtin_var_requires(args[0],ScriptStringValue);
                 std::filesystem::create_directory(get_value<ScriptStringValue>(args[0]));
                 return script_null;
             }}},
             {"exists",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-                cc_builtin_if_ignore();
                 cc_builtin_var_requires(args[0],ScriptStringValue);
                 return std::filesystem::exists(get_value<ScriptStringValue>(args[0])) ? script_true : script_false;
             }}},
             {"remove",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-                cc_builtin_if_ignore();
                 cc_builtin_var_requires(args[0],ScriptStringValue);
                 return std::filesystem::remove_all(get_value<ScriptStringValue>(args[0])) ? script_true : script_false;
             }}},
             {"copy",{2,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-                cc_builtin_if_ignore();
                 cc_builtin_var_requires(args[0],ScriptStringValue);
                 cc_builtin_var_requires(args[1],ScriptStringValue);
-                try {
-                    std::filesystem::copy(get_value<ScriptStringValue>(args[0]),get_value<ScriptStringValue>(args[1]));
-                }
-                catch(...) { return script_false; }
-                return script_true;
+                return copy_path(get_value<ScriptStringValue>(args[0]),get_value<ScriptStringValue>(args[1])) ? script_false : script_true;
             }}},
             {"move",{2,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-                cc_builtin_if_ignore();
                 cc_builtin_var_requires(args[0],ScriptStringValue);
                 cc_builtin_var_requires(args[1],ScriptStringValue);
-                try {
-                    std::filesystem::copy(get_value<ScriptStringValue>(args[0]),get_value<ScriptStringValue>(args[1]));
-                    std::filesystem::remove_all(get_value<ScriptStringValue>(args[0]));
-                }
-                catch(...) { return script_false; }
-                return script_true;
+                return move_path(get_value<ScriptStringValue>(args[0]),get_value<ScriptStringValue>(args[1])) ? script_false : script_true;
+            }}},
+
+            {"glob",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
+                cc_builtin_var_requires(args[0],ScriptStringValue);
+                return new ScriptIteratorValue(std::make_shared<GlobIterator>(get_value<ScriptStringValue>(args[0])));
+            }}},
+            // the bulk operations take a path, a list or an iterator (like glob)
+            // and return a list of the paths they failed on
+            {"copy_files",{2,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
+                cc_builtin_var_requires(args[1],ScriptStringValue);
+                return script_bulk_operation(FileOperation::COPY,args[0],get_value<ScriptStringValue>(args[1]),settings);
+            }}},
+            {"move_files",{2,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
+                cc_builtin_var_requires(args[1],ScriptStringValue);
+                return script_bulk_operation(FileOperation::MOVE,args[0],get_value<ScriptStringValue>(args[1]),settings);
+            }}},
+            {"remove_files",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
+                return script_bulk_operation(FileOperation::REMOVE,args[0],"",settings);
+            }}},
+            {"list_directory",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
+                cc_builtin_var_requires(args[0],ScriptStringValue);
+                std::error_code ec;
+                std::filesystem::directory_iterator it(get_value<ScriptStringValue>(args[0]),ec);
+                if(ec) _cc_error("can't list directory: " + get_value<ScriptStringValue>(args[0]));
+                return new ScriptIteratorValue(std::make_shared<DirectoryIterator>(it));
             }}},
             
             {"installed",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-                cc_builtin_if_ignore();
                 cc_builtin_var_requires(args[0],ScriptStringValue);
                 return installed(get_value<ScriptStringValue>(args[0])) ? script_true : script_false;
             }}},
             {"add_project",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-                cc_builtin_if_ignore();
                 cc_builtin_var_requires(args[0],ScriptStringValue);
                 settings.error_msg = download_project(get_value<ScriptStringValue>(args[0]));
                 return script_null;
             }}},
             {"resolve",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-                cc_builtin_if_ignore();
                 cc_builtin_var_requires(args[0],ScriptStringValue);
                 auto urls = get_download_url(to_lowercase(get_value<ScriptStringValue>(args[0])));
                 if(urls.size() > 1) {
@@ -113,7 +266,6 @@ public:
                 return urls[0].link;
             }}},
             {"download_project",{2,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-                cc_builtin_if_ignore();
                 cc_builtin_var_requires(args[0],ScriptStringValue);
                 cc_builtin_var_requires(args[1],ScriptStringValue);
                 
@@ -156,13 +308,11 @@ public:
             }}},
 
             {"get_config",{1,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-                cc_builtin_if_ignore();
                 cc_builtin_var_requires(args[0],ScriptStringValue);
 
                 return options[get_value<ScriptStringValue>(args[0])];
             }}},
             {"set_config",{2,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-                cc_builtin_if_ignore();
                 cc_builtin_var_requires(args[0],ScriptStringValue);
                 cc_builtin_var_requires(args[1],ScriptStringValue);
 
@@ -170,15 +320,15 @@ public:
             }}},
         
             {"checklist",{2,[](const ScriptArglist& args, ScriptSettings& settings)->ScriptVariable {
-                cc_builtin_if_ignore();
                 cc_builtin_var_requires(args[0],ScriptStringValue);
                 cc_builtin_var_requires(args[1],ScriptStringValue);
                 IniFile checklist = IniFile::from_file(get_value<ScriptStringValue>(args[0]));
                 if(!checklist) { settings.error_msg = checklist.error_msg(); return script_null; }
                 std::string option = get_value<ScriptStringValue>(args[1]);
-                std::string ret = (std::string)checklist.get(option,"Info");
+                std::string section = checklist.has(option,"Info") || !checklist.has(option,"Download") ? "Info" : "Download";
+                IniElement ret = checklist.get(option,section);
                 if(!checklist) { settings.error_msg = checklist.error_msg(); return script_null; }
-                return ret;
+                return ini_to_script(ret);
             }}},
         };
     }
@@ -204,5 +354,6 @@ public:
 };
 
 CARESCRIPT_EXTENSION_GETEXT_INLINE(
-    return new CCSExtension();
+    static CCSExtension extension;
+    return &extension;
 )
\ No newline at end of file
@@ -4,7 +4,7 @@
 #include "network.hpp"
 #include "../mods/inipp.hpp"
 
-inline static RuleList global_rulelist;
+inline static RuleMatcher global_rulelist;
 
 void make_file(std::string name, std::string std = "");
 void fill_global_pagelist();
@@ -15,8 +15,11 @@ std::string healthcheck_localconf();
 void delete_localconf();
 void write_localconf();
 
-namespace carescript { struct Interpreter; }
+namespace carescript { class Interpreter; struct InterpreterState; }
 void load_extensions(carescript::Interpreter& interp);
+// the fully baked interpreter state every script starts from,
+// it is built once per process on first use
+const carescript::InterpreterState& script_prototype();
 
 IniDictionary extract_configs(IniFile file);
 
@@ -25,6 +28,23 @@ bool valid_configs(IniDictionary conf);
 std::string config_healthcare(IniDictionary conf);
 
 void make_register();
+
+// while a transaction is open, changes to the register and the dependency
+// list are only collected, so several installs can run at the same time
+void begin_register_transaction();
+// writes the collected changes, every file is replaced at once
+void commit_register_transaction();
+// drops the collected changes, removes the projects installed meanwhile
+// and restores the ones that were reinstalled
+void rollback_register_transaction();
+// marks url as being installed, false if it already is in this transaction.
+// with wait, error then gets the result of the install that claimed it
+bool claim_install(std::string url, std::string& error, bool wait);
+// hands the result of a claimed install to those waiting for it
+void finish_install(std::string url, std::string error);
+// clears the way for installing name, inside a transaction the project
+// installed before is kept until the commit
+void replace_project(std::string name);
 IniDictionary get_register();
 bool installed(std::string name);
 void add_to_register(std::string url, std::string name);
@@ -37,6 +57,29 @@ IniList get_dependencylist();
 
 std::string url2name(std::string url);
 
+// sha256 of the file content
+std::string hash_file(const std::string& path);
+// hash lists, as in cat_lock.inipp and the "hashes" of a checklist
+// relative path -> sha256
+std::map<std::string,std::string> parse_file_hashes(IniList list);
+IniList make_file_hashes(const std::map<std::string,std::string>& hashes);
+
+// what was installed for a project, as recorded in cat_lock.inipp
+struct LockEntry {
+    std::string url;
+    std::string version;
+    // relative path -> sha256 of the content
+    std::map<std::string,std::string> files;
+};
+// project name -> entry
+std::map<std::string,LockEntry> read_lockfile();
+// hashes the installed files of name and records them with url and version
+void lock_project(std::string url, std::string name, std::string version);
+// name may also be the url of the project
+void unlock_project(std::string name);
+// true if every locked file of name is installed with the locked content
+bool matches_lock(const LockEntry& entry, std::string name);
+
 void make_checklist();
 
 IniList get_filelist();
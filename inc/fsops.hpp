@@ -0,0 +1,55 @@
+#ifndef FSOPS_HPP
+#define FSOPS_HPP
+
+#include <string>
+#include <vector>
+#include <deque>
+#include <filesystem>
+#include <system_error>
+
+// matches a single path component against a pattern with * and ?
+bool glob_match(const std::string& pattern, const std::string& name);
+
+// walks the file system lazily and yields every path matching a pattern
+// pattern components may use *, ? and ** (any number of directories)
+class GlobWalker {
+    struct Level {
+        std::filesystem::path dir;
+        size_t component = 0;
+        std::filesystem::directory_iterator it;
+    };
+    std::vector<std::string> components;
+    std::vector<Level> levels;
+    std::deque<std::filesystem::path> matches;
+
+    void enter(const std::filesystem::path& dir, size_t component);
+public:
+    GlobWalker(std::string pattern);
+
+    // stores the next match in path, returns false once exhausted
+    bool next(std::filesystem::path& path);
+};
+
+// moves with rename(2), copies and removes only across devices
+std::error_code move_path(const std::filesystem::path& from, const std::filesystem::path& to);
+
+// copies a file or directory tree, files are reflinked if the file system
+// supports it and copied in kernel space with copy_file_range otherwise
+std::error_code copy_path(const std::filesystem::path& from, const std::filesystem::path& to);
+
+// copies a single regular file, overwriting to
+std::error_code copy_file_fast(const std::filesystem::path& from, const std::filesystem::path& to);
+
+std::error_code remove_path(const std::filesystem::path& path);
+
+enum class FileOperation {
+    COPY,
+    MOVE,
+    REMOVE
+};
+
+// runs op on every path on the worker pool, copies and moves go into the
+// directory dest, returns the paths that failed together with their errors
+std::vector<std::pair<std::filesystem::path,std::error_code>> bulk_file_operation(FileOperation op, const std::vector<std::filesystem::path>& paths, const std::filesystem::path& dest = "");
+
+#endif
@@ -0,0 +1,13 @@
+#ifndef HASHING_HPP
+#define HASHING_HPP
+
+#include <string>
+#include <cstdint>
+
+// fast non-cryptographic hash, used to key caches
+std::uint64_t fnv1a(const std::string& data, std::uint64_t seed = 0xcbf29ce484222325ULL);
+std::string to_hex(std::uint64_t value);
+// content hash for files recorded in the lockfile, as lowercase hex
+std::string sha256(const std::string& data);
+
+#endif
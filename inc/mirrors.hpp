@@ -0,0 +1,33 @@
+#ifndef MIRRORS_HPP
+#define MIRRORS_HPP
+
+#include <string>
+#include <vector>
+#include <chrono>
+
+// how a mirror host performed so far, older results weigh less
+struct MirrorStats {
+    double successes = 0;
+    double failures = 0;
+    // moving average of the time to the first byte of successful
+    // requests in milliseconds, independent of the size of the file
+    double latency = 0;
+
+    // hosts failing most of their recent requests are only tried last
+    bool healthy() const { return successes + failures < 3 || successes >= failures; }
+};
+
+// scheme and host of an url, the key the statistics are kept under
+std::string mirror_host(const std::string& url);
+
+// time is how long the host took to start answering
+void record_mirror(const std::string& url, bool success, std::chrono::milliseconds time);
+
+// orders the links of one package by preference: healthy hosts before
+// failing ones, faster hosts first, hosts without results are tried first
+std::vector<std::string> rank_mirrors(std::vector<std::string> links);
+
+// writes the statistics to the cache directory
+void save_mirror_stats();
+
+#endif
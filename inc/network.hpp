@@ -6,13 +6,17 @@
 #include <iostream>
 #include <filesystem>
 #include <stdlib.h>
+#include <chrono>
 
 #include "../mods/inipp.hpp"
 #include "options.hpp"
 #include "../inc/pagelist.hpp"
 
 std::string get_username();
-bool download_page(std::string url, std::string file);
+// without retry a failed transfer is given up at once, for callers
+// that have another mirror to try. first_byte gets the time until the
+// server started sending the file
+bool download_page(std::string url, std::string file, bool retry = true, std::chrono::milliseconds* first_byte = nullptr);
 
 #define CATCARE_PROGNAME "catcaretaker"
 
@@ -44,26 +48,73 @@ inline void cat_sleep(unsigned int mil) { Sleep(mil); }
 #define CATCARE_EXTENSION_PATH CATCARE_HOME CATCARE_EXTENSION_DIR
 #define CATCARE_ATTACHMENT_DIR "attachments"
 #define CATCARE_ATTACHMENT_PATH CATCARE_HOME CATCARE_ATTACHMENT_DIR
+#define CATCARE_CACHE_DIR "cache"
+#define CATCARE_CACHE_PATH CATCARE_HOME CATCARE_CACHE_DIR
+#define CATCARE_RESUME_DIR "resume"
+#define CATCARE_RESUME_PATH CATCARE_HOME CATCARE_RESUME_DIR
 
 
 #define CATCARE_CHECKLISTNAME "cat_checklist.inipp"
 #define CATCARE_REGISTERNAME "cat_register.inipp"
+#define CATCARE_LOCKNAME "cat_lock.inipp"
 #define CATCARE_RELEASES_FILE "releases.inipp"
 #define CATCARE_BROWSING_FILE "browsing.inipp"
 
 #define CATCARE_ROOT_NAME std::string("catpkgs")
 #define CATCARE_ROOT (!arg_settings::global ? CATCARE_ROOT_NAME : CATCARE_HOME + CATCARE_ROOT_NAME)
+#define CATCARE_LOCK_FILE (!arg_settings::global ? std::string(CATCARE_LOCKNAME) : CATCARE_HOME CATCARE_LOCKNAME)
 #define CATCARE_BROWSE_OFFICIAL "https://raw.githubusercontent.com/labricecat/catcaretaker/main/" CATCARE_BROWSING_FILE
 #define CATCARE_CARESCRIPT_EXT ".ccs"
 
 
 std::vector<UrlPackage> get_download_url(std::string input);
+
+// what a package spec resolved to, more than one candidate means it's ambiguous
+struct Resolution {
+    std::string spec;
+    std::vector<UrlPackage> candidates;
+
+    bool resolved() const { return candidates.size() == 1; }
+    bool ambiguous() const { return candidates.size() > 1; }
+};
+// resolves all specs without asking, the results are in the order of specs
+// resolutions are remembered until urlrules.ccr changes
+std::vector<Resolution> resolve_batch(const std::vector<std::string>& specs);
 void download_dependencies(IniList list);
 
-std::string download_project(std::string url);
+// mirrors are the links of all mirrors of url, including url itself
+std::string download_project(std::string url, std::vector<std::string> mirrors = {});
 IniFile download_checklist(std::string url);
+// updates an installed project file by file, using the "hashes" of the
+// remote checklist. false if that isn't possible, reinstall it then
+// mirrors as for download_project
+bool delta_update(std::string url, std::string name, std::vector<std::string> mirrors = {});
 
 // new - old (new == "" when no update needed)
 std::tuple<std::string,std::string> needs_update(std::string name);
 
+// what sync has to change so the installed projects match the dependency list
+struct SyncPlan {
+    struct Step {
+        std::string name;
+        std::string url;
+        std::string reason;
+        // url and its mirrors, empty if it has none
+        std::vector<std::string> mirrors;
+    };
+    std::vector<Step> add;
+    std::vector<Step> update;
+    std::vector<Step> remove;
+    // installed without a lock entry, but already at the remote version
+    std::vector<Step> lock;
+    std::vector<Step> keep;
+
+    bool empty() const { return add.empty() && update.empty() && remove.empty() && lock.empty(); }
+};
+// diffs the dependency list (followed through the installed projects),
+// the register, the lockfile and the remote versions
+SyncPlan plan_sync();
+// false if any project failed to install
+bool apply_sync(const SyncPlan& plan);
+
 #endif
\ No newline at end of file
@@ -11,6 +11,7 @@ namespace arg_settings {
     inline bool opt_silence = false;
     inline bool global = false;
     inline bool no_config = false;
+    inline bool profile_scripts = false;
 }
 
 inline std::map<std::string,std::string> options;
@@ -5,6 +5,9 @@
 #include <string>
 #include <unordered_map>
 #include <functional>
+#include <filesystem>
+#include <cstdint>
+#include <algorithm>
 
 #include "../mods/kittenlexer.hpp"
 
@@ -21,6 +24,8 @@ struct Rule {
     std::string name;
     std::vector<char> symbols;
     Url link;
+    // further links with the same placeholders serving the same files
+    std::vector<Url> mirrors;
     std::map<std::string,int> positions;
     std::map<int,std::string> rvpositions;
     std::map<std::string,std::string> defaults;
@@ -34,6 +39,7 @@ struct Rule {
     void merge(Rule rule) {
         symbols = rule.symbols;
         link = rule.link;
+        mirrors = rule.mirrors;
         positions = rule.positions;
         defaults = rule.defaults;
         scripts = rule.scripts;
@@ -43,10 +49,23 @@ struct Rule {
 };
 using RuleList = std::unordered_map<std::string,Rule>;
 
+// all rules indexed by the shape of the inputs they accept, the shape of
+// "user/project@branch" is its number of parts and its separators "/@"
+struct RuleMatcher {
+    std::vector<Rule> rules;
+    std::unordered_map<std::string,std::vector<size_t>> shapes;
+    // hash of the source the rules were compiled from
+    std::uint64_t source_hash = 0;
+
+    bool empty() const { return rules.empty(); }
+};
+
 struct UrlPackage {
     Rule rule;
     std::string link;
     std::map<std::string,std::string> pairs;
+    // link followed by the resolved mirrors of the rule
+    std::vector<std::string> mirrors;
 };
 
 static inline bool is_message_split_sign(char c) {
@@ -69,10 +88,19 @@ static inline bool is_message_split_sign(char c) {
     return false;
 }
 RuleList process_rulelist(std::string source);
+RuleMatcher compile_rules(const RuleList& rules);
+
+// bump when Rule or RuleMatcher change
+#define CATCARE_RULES_CACHE_VERSION "2"
+
+// stores compiled rules, key identifies the source they were compiled from
+bool save_rules(const std::filesystem::path& path, std::uint64_t key, const RuleMatcher& matcher);
+// fails if there is no cache for key
+bool load_rules(const std::filesystem::path& path, std::uint64_t key, RuleMatcher& matcher);
 
 Url parse_link(std::string source);
 
-std::vector<UrlPackage> find_url(RuleList list, std::string string);
+std::vector<UrlPackage> find_url(const RuleMatcher& matcher, const std::string& string);
 
 bool is_url(std::string check);
 
@@ -104,9 +132,21 @@ static inline std::unordered_map<std::string,std::function<std::string(std::vect
     }},
     {"LINK",[](std::vector<KittenToken> args, Rule*& rule, RuleList& rules) -> std::string {
         HASRULE();
-        NEEDARG(1);
+        if(args.size() == 0) ERR("command needs at least one argument");
         ISSTRING(0);
         rule->link = parse_link(args[0].src);
+        // every further link is a mirror of the first one
+        rule->mirrors.clear();
+        std::vector<std::string> placeholders = rule->link.placeholders;
+        std::sort(placeholders.begin(),placeholders.end());
+        for(size_t i = 1; i < args.size(); ++i) {
+            ISSTRING(i);
+            Url mirror = parse_link(args[i].src);
+            std::vector<std::string> mirror_placeholders = mirror.placeholders;
+            std::sort(mirror_placeholders.begin(),mirror_placeholders.end());
+            if(mirror_placeholders != placeholders) ERR("mirror needs the same placeholders as the first link: " + args[i].src);
+            rule->mirrors.push_back(mirror);
+        }
         return "";
     }},
     {"DEFAULT",[](std::vector<KittenToken> args, Rule*& rule, RuleList& rules) -> std::string {
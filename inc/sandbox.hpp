@@ -0,0 +1,24 @@
+#ifndef SANDBOX_HPP
+#define SANDBOX_HPP
+
+#include <string>
+#include <functional>
+
+struct SandboxLimits {
+    // wall clock and cpu seconds, 0 -> no cpu limit and
+    // CATCARE_SANDBOX_TIMEOUT seconds of wall clock
+    unsigned int timeout = 0;
+    // address space in megabytes, 0 -> unlimited
+    unsigned int memory = 0;
+};
+
+// runs fn in a forked child process with resource limits, the child is
+// killed once the timeout runs out
+// what fn returns is handed back through payload, error is set if the
+// child didn't finish on its own or fn set a status other than 0
+// the child is a copy, nothing fn changes (variables, profiler data, ...)
+// reaches the calling process, only the payload does
+// without fork (Windows) fn runs in the calling process
+bool run_sandboxed(std::function<std::string(int& status)> fn, SandboxLimits limits, std::string& payload, std::string& error);
+
+#endif
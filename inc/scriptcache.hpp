@@ -0,0 +1,20 @@
+#ifndef SCRIPTCACHE_HPP
+#define SCRIPTCACHE_HPP
+
+#include <string>
+#include <filesystem>
+
+#include "../carescript/carescript-api.hpp"
+
+// bump when the layout of pre processed labels changes
+#define CATCARE_SCRIPT_CACHE_VERSION "6"
+
+// reads a whole script file
+std::string read_script(std::filesystem::path path);
+
+// same as Interpreter::pre_process, but reuses the labels stored in the
+// script cache when the same source was already pre processed with the
+// same builtins, operators and macros
+carescript::InterpreterError load_script(carescript::Interpreter& interp, const std::string& source);
+
+#endif
@@ -0,0 +1,49 @@
+#ifndef SCRIPTRUNNER_HPP
+#define SCRIPTRUNNER_HPP
+
+#include <string>
+#include <vector>
+#include <memory>
+#include <filesystem>
+
+#include "../carescript/carescript-api.hpp"
+
+// a script that doesn't depend on any other script running before it
+struct IsolatedScript {
+    std::string name;
+    std::string source;
+    std::string label = "main";
+    carescript::ScriptArglist args;
+};
+
+struct IsolatedResult {
+    std::string output;
+    std::string error;
+};
+
+// gives interp a fresh budget from the script_max_instructions,
+// script_timeout and script_max_depth options and attaches the profiler
+void limit_script(carescript::Interpreter& interp);
+
+// runs a label of a loaded script under the configured limits, in a forked
+// child if script_sandbox is set, returns the error of the run
+// exit with a status other than 0 counts as an error
+// a sandboxed run leaves interp as it was, its variables and profile stay
+// in the child
+std::string run_limited(carescript::Interpreter& interp, std::string label = "main", carescript::ScriptArglist args = {});
+
+// runs every script in its own interpreter on a thread pool, output is
+// collected per script, the results are in the order of scripts
+std::vector<IsolatedResult> run_isolated(const std::vector<IsolatedScript>& scripts);
+
+// prints the results of run_isolated in order, what names the kind of script
+void print_isolated(const std::vector<IsolatedScript>& scripts, const std::vector<IsolatedResult>& results, std::string what);
+
+// shared by all interpreters if --profile-scripts is given, null otherwise
+std::shared_ptr<carescript::ScriptProfiler> script_profiler();
+
+// prints a summary of the profiled scripts and writes their
+// stacks as folded lines (microseconds) to file for flamegraphs
+void report_profile(std::filesystem::path file);
+
+#endif
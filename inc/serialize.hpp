@@ -0,0 +1,79 @@
+#ifndef SERIALIZE_HPP
+#define SERIALIZE_HPP
+
+#include <string>
+#include <cstdint>
+#include <fstream>
+#include <filesystem>
+#include <random>
+
+// minimal helpers to write and read the binary cache files.
+// the reader never throws, it sets `good` to false on a short read
+struct BinaryWriter {
+    std::string data;
+
+    BinaryWriter& u32(std::uint32_t v) {
+        for(int i = 0; i < 4; ++i) data += (char)((v >> (i * 8)) & 0xff);
+        return *this;
+    }
+    BinaryWriter& u64(std::uint64_t v) {
+        for(int i = 0; i < 8; ++i) data += (char)((v >> (i * 8)) & 0xff);
+        return *this;
+    }
+    BinaryWriter& str(const std::string& s) {
+        u32(s.size());
+        data += s;
+        return *this;
+    }
+
+    // writes to a temporary file first so readers never see half a file
+    bool to_file(const std::filesystem::path& path) const {
+        // unique, so concurrent writers of the same file don't collide
+        std::filesystem::path tmp = path;
+        tmp += ".tmp" + std::to_string(std::random_device{}());
+        std::ofstream of(tmp,std::ios::binary | std::ios::trunc);
+        if(!of) return false;
+        of.write(data.data(),data.size());
+        of.close();
+        std::error_code ec;
+        std::filesystem::rename(tmp,path,ec);
+        if(ec) std::filesystem::remove(tmp,ec);
+        return !ec;
+    }
+};
+
+struct BinaryReader {
+    std::string data;
+    size_t pos = 0;
+    bool good = true;
+
+    static BinaryReader from_file(const std::filesystem::path& path) {
+        BinaryReader r;
+        std::ifstream ifile(path,std::ios::binary);
+        if(!ifile) { r.good = false; return r; }
+        r.data.assign(std::istreambuf_iterator<char>(ifile),std::istreambuf_iterator<char>());
+        return r;
+    }
+
+    std::uint32_t u32() {
+        if(!good || pos + 4 > data.size()) { good = false; return 0; }
+        std::uint32_t v = 0;
+        for(int i = 0; i < 4; ++i) v |= (std::uint32_t)(unsigned char)data[pos++] << (i * 8);
+        return v;
+    }
+    std::uint64_t u64() {
+        if(!good || pos + 8 > data.size()) { good = false; return 0; }
+        std::uint64_t v = 0;
+        for(int i = 0; i < 8; ++i) v |= (std::uint64_t)(unsigned char)data[pos++] << (i * 8);
+        return v;
+    }
+    std::string str() {
+        std::uint32_t size = u32();
+        if(!good || pos + size > data.size()) { good = false; return ""; }
+        std::string s = data.substr(pos,size);
+        pos += size;
+        return s;
+    }
+};
+
+#endif
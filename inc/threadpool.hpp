@@ -0,0 +1,86 @@
+#ifndef THREADPOOL_HPP
+#define THREADPOOL_HPP
+
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <future>
+#include <queue>
+#include <vector>
+#include <memory>
+#include <algorithm>
+
+// fixed size pool of worker threads running queued jobs in order
+class ThreadPool {
+    std::vector<std::thread> workers;
+    std::queue<std::function<void()>> jobs;
+    std::mutex mutex;
+    std::condition_variable condition;
+    bool stopping = false;
+
+    void work() {
+        while(true) {
+            std::function<void()> job;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                condition.wait(lock,[this]{ return stopping || !jobs.empty(); });
+                if(jobs.empty()) return;
+                job = std::move(jobs.front());
+                jobs.pop();
+            }
+            job();
+        }
+    }
+public:
+    ThreadPool(size_t threads) {
+        if(threads == 0) threads = 1;
+        for(size_t i = 0; i < threads; ++i)
+            workers.emplace_back([this]{ work(); });
+    }
+    ThreadPool(const ThreadPool&) = delete;
+    ThreadPool& operator=(const ThreadPool&) = delete;
+
+    // finishes all queued jobs before returning
+    ~ThreadPool() {
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            stopping = true;
+        }
+        condition.notify_all();
+        for(auto& i : workers) i.join();
+    }
+
+    size_t size() const { return workers.size(); }
+
+    // set in forked children, where the worker threads don't exist
+    // anymore, jobs run right away on the submitting thread then
+    static bool& run_inline() {
+        static bool value = false;
+        return value;
+    }
+
+    template<typename _Fn>
+    auto submit(_Fn fn) -> std::future<decltype(fn())> {
+        auto task = std::make_shared<std::packaged_task<decltype(fn())()>>(std::move(fn));
+        std::future<decltype(fn())> ret = task->get_future();
+        if(run_inline()) {
+            (*task)();
+            return ret;
+        }
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            jobs.push([task]{ (*task)(); });
+        }
+        condition.notify_one();
+        return ret;
+    }
+};
+
+// pool shared by the bulk file operations, sized after the machine
+inline ThreadPool& worker_pool() {
+    static ThreadPool pool(std::min(8u,std::max(2u,std::thread::hardware_concurrency())));
+    return pool;
+}
+
+#endif
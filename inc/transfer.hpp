@@ -0,0 +1,30 @@
+#ifndef TRANSFER_HPP
+#define TRANSFER_HPP
+
+#include <string>
+#include <vector>
+#include <future>
+
+#include "threadpool.hpp"
+
+// runs downloads on a fixed number of connections, used by package
+// installs and the async script builtins alike
+class TransferEngine {
+    ThreadPool pool;
+public:
+    TransferEngine(size_t connections);
+
+    // queues a download of url into file, the future is true on success
+    std::shared_future<bool> enqueue(std::string url, std::string file);
+    // tries the links one after another until one serves path, the
+    // results are recorded in the mirror statistics
+    std::shared_future<bool> enqueue(std::vector<std::string> links, std::string path, std::string file);
+
+    size_t connections() const { return pool.size(); }
+};
+
+// the process wide engine, the connection count is read from the
+// download_connections option on first use
+TransferEngine& transfer_engine();
+
+#endif
@@ -0,0 +1,246 @@
+#include "../inc/archive.hpp"
+
+#include <fstream>
+#include <memory>
+#include <set>
+#include <cstdint>
+#include <cstring>
+
+#ifdef __linux__
+#include <curl/curl.h>
+#include <zlib.h>
+
+// tar is a row of 512 byte blocks: a header, then the content padded to a
+// full block. only the regular files asked for are written
+class _TarStream {
+    const std::map<std::string,std::string>& files;
+    std::string header;
+    // content and padding left of the current member
+    std::uint64_t remaining = 0;
+    std::uint64_t padding = 0;
+    // 'f' file to write, 'L' GNU long name, 'x' pax header, 0 skipped
+    char kind = 0;
+    std::ofstream out;
+    std::string meta;
+    // long names and pax paths replace the name of the next member
+    std::string next_name;
+    int zero_blocks = 0;
+
+    static std::uint64_t parse_size(const char* field) {
+        std::uint64_t ret = 0;
+        // base-256, for members of 8GiB and more
+        if(field[0] & 0x80) {
+            for(int i = 1; i < 12; ++i) ret = (ret << 8) | (unsigned char)field[i];
+            return ret;
+        }
+        for(int i = 0; i < 12 && field[i] >= '0' && field[i] <= '7'; ++i) ret = ret * 8 + (field[i] - '0');
+        return ret;
+    }
+
+    static std::string field(const std::string& block, size_t offset, size_t size) {
+        std::string ret = block.substr(offset,size);
+        return ret.substr(0,ret.find('\0'));
+    }
+
+    // the destination of an archive path, archives of branches keep
+    // everything below a directory named after the project
+    const std::string* match(std::string name, std::string& key) {
+        if(name.rfind("./",0) == 0) name.erase(0,2);
+        for(int i = 0; i < 2; ++i) {
+            auto it = files.find(name);
+            if(it != files.end()) {
+                key = it->first;
+                return &it->second;
+            }
+            size_t slash = name.find('/');
+            if(slash == std::string::npos) break;
+            name.erase(0,slash + 1);
+        }
+        return nullptr;
+    }
+
+    void read_header() {
+        if(header.find_first_not_of('\0') == std::string::npos) {
+            if(++zero_blocks == 2) finished = true;
+            return;
+        }
+        zero_blocks = 0;
+
+        std::string name = field(header,0,100);
+        if(header.compare(257,5,"ustar") == 0 && header[345] != '\0') {
+            name = field(header,345,155) + "/" + name;
+        }
+        if(next_name != "") {
+            name = next_name;
+            next_name = "";
+        }
+        remaining = parse_size(header.data() + 124);
+        padding = (512 - remaining % 512) % 512;
+
+        char type = header[156];
+        kind = 0;
+        if(type == 'L' || type == 'x') {
+            kind = type;
+        }
+        else if(type == '0' || type == '\0') {
+            std::string key;
+            const std::string* file = match(name,key);
+            if(file) {
+                out.open(*file,std::ios::binary | std::ios::trunc);
+                if(!out) {
+                    error = "Could not write " + *file;
+                    finished = true;
+                    return;
+                }
+                kind = 'f';
+                written.insert(key);
+            }
+        }
+        if(remaining == 0) end_member();
+    }
+
+    void end_member() {
+        if(kind == 'f') {
+            out.close();
+        }
+        else if(kind == 'L') {
+            next_name = meta.substr(0,meta.find('\0'));
+        }
+        else if(kind == 'x') {
+            // records look like "<length> <key>=<value>\n"
+            for(size_t pos = 0; pos < meta.size();) {
+                size_t space = meta.find(' ',pos);
+                if(space == std::string::npos) break;
+                size_t length = std::strtoull(meta.c_str() + pos,nullptr,10);
+                if(length == 0 || pos + length > meta.size()) break;
+                std::string record = meta.substr(space + 1,pos + length - space - 2);
+                if(record.rfind("path=",0) == 0) next_name = record.substr(5);
+                pos += length;
+            }
+        }
+        meta.clear();
+        kind = 0;
+    }
+public:
+    std::set<std::string> written;
+    bool finished = false;
+    std::string error;
+
+    _TarStream(const std::map<std::string,std::string>& files): files(files) {}
+
+    void feed(const char* data, size_t size) {
+        while(size > 0 && !finished) {
+            size_t n;
+            if(remaining > 0) {
+                n = std::min<std::uint64_t>(remaining,size);
+                if(kind == 'f') out.write(data,n);
+                else if(kind != 0) meta.append(data,n);
+                remaining -= n;
+                if(remaining == 0) end_member();
+            }
+            else if(padding > 0) {
+                n = std::min<std::uint64_t>(padding,size);
+                padding -= n;
+            }
+            else {
+                n = std::min(512 - header.size(),size);
+                header.append(data,n);
+                if(header.size() == 512) {
+                    read_header();
+                    header.clear();
+                }
+            }
+            data += n;
+            size -= n;
+        }
+    }
+};
+
+// gzip is inflated on the fly, plain tar is passed through
+struct _ArchiveStream {
+    _TarStream tar;
+    z_stream zs{};
+    // -1 undecided, 0 plain, 1 gzip
+    int gzip = -1;
+    bool ended = false;
+
+    _ArchiveStream(const std::map<std::string,std::string>& files): tar(files) {}
+    ~_ArchiveStream() { if(gzip == 1) inflateEnd(&zs); }
+
+    bool feed(const char* data, size_t size) {
+        if(gzip == -1) {
+            gzip = size >= 2 && (unsigned char)data[0] == 0x1f && (unsigned char)data[1] == 0x8b;
+            if(gzip == 1 && inflateInit2(&zs,15 + 16) != Z_OK) {
+                gzip = 0;
+                tar.error = "Could not start decompressing";
+                return false;
+            }
+        }
+        if(gzip == 0) {
+            tar.feed(data,size);
+            return tar.error == "";
+        }
+
+        char buffer[16384];
+        zs.next_in = (Bytef*)data;
+        zs.avail_in = size;
+        while(zs.avail_in > 0 && !tar.finished) {
+            // concatenated gzip members continue the same tar
+            if(ended) {
+                inflateReset(&zs);
+                ended = false;
+            }
+            zs.next_out = (Bytef*)buffer;
+            zs.avail_out = sizeof(buffer);
+            int ret = inflate(&zs,Z_NO_FLUSH);
+            if(ret != Z_OK && ret != Z_STREAM_END && ret != Z_BUF_ERROR) {
+                tar.error = "Archive is corrupted";
+                return false;
+            }
+            tar.feed(buffer,sizeof(buffer) - zs.avail_out);
+            if(ret == Z_STREAM_END) ended = true;
+            if(ret == Z_BUF_ERROR) break;
+        }
+        return tar.error == "";
+    }
+
+    static size_t write(char* data, size_t size, size_t count, void* self) {
+        return ((_ArchiveStream*)self)->feed(data,size * count) ? size * count : 0;
+    }
+};
+
+std::string download_archive(std::string url, const std::map<std::string,std::string>& files) {
+    std::unique_ptr<CURL,void(*)(CURL*)> handle(curl_easy_init(),curl_easy_cleanup);
+    CURL* curl = handle.get();
+    if(!curl) return "Could not start the download";
+
+    _ArchiveStream stream(files);
+    curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+    // forges redirect archive requests to their download hosts
+    curl_easy_setopt(curl, CURLOPT_FOLLOWLOCATION, 1L);
+    curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, _ArchiveStream::write);
+    curl_easy_setopt(curl, CURLOPT_WRITEDATA, &stream);
+    CURLcode res = curl_easy_perform(curl);
+    long http_code = 0;
+    curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
+
+    if(http_code >= 400 && http_code <= 599) return "Could not download archive (HTTP " + std::to_string(http_code) + ")";
+    if(stream.tar.error != "") return stream.tar.error;
+    if(res != CURLE_OK) return std::string("Could not download archive: ") + curl_easy_strerror(res);
+    if(!stream.tar.finished && !(stream.gzip == 1 && stream.ended)) return "Archive is incomplete";
+
+    std::string missing;
+    for(const auto& i : files) {
+        if(stream.tar.written.count(i.first) == 0) missing += (missing == "" ? "" : ", ") + i.first;
+    }
+    if(missing != "") return "Not in the archive: " + missing;
+    return "";
+}
+
+#else
+
+std::string download_archive(std::string url, const std::map<std::string,std::string>& files) {
+    return "Archives are not supported on this platform";
+}
+
+#endif
@@ -2,8 +2,15 @@
 #include "../inc/options.hpp"
 #include "../inc/pagelist.hpp"
 #include "../carescript/carescript-api.hpp"
+#include "../inc/catcaretaker-ccs-extension.hpp"
+#include "../inc/serialize.hpp"
+#include "../inc/hashing.hpp"
 
 #include <string.h>
+#include <future>
+#include <mutex>
+#include <set>
+#include <sstream>
 
 static std::streamsize get_flength(std::ifstream& file) {
 	if(!file.is_open()) {
@@ -73,6 +80,8 @@ std::string healthcheck_localconf() {
         std::filesystem::create_directory(CATCARE_MACRO_PATH);
     if(!std::filesystem::exists(CATCARE_EXTENSION_PATH))
         std::filesystem::create_directory(CATCARE_EXTENSION_PATH);
+    if(!std::filesystem::exists(CATCARE_CACHE_PATH))
+        std::filesystem::create_directory(CATCARE_CACHE_PATH);
     if(!std::filesystem::exists(CATCARE_URLRULES_FILE))
         make_file(CATCARE_URLRULES_FILE,R"(
 "--- urlrules.ccr ---"
@@ -107,7 +116,7 @@ void load_localconf() {
         options[i.first] = (std::string)i.second;
     }
     // IniDictionary b = file.get("blacklist") TODO
-    fill_global_pagelist();
+    // the url rules are loaded on the first lookup, see get_download_url
 }
 
 void delete_localconf() {
@@ -128,12 +137,138 @@ void write_localconf() {
     file.to_file(CATCARE_CONFIG_FILE);
 }
 
+// what an extension provides, so it doesn't have to be opened to know it
+struct ExtensionManifestEntry {
+    std::uint64_t time = 0;
+    std::uint64_t size = 0;
+    // extensions with operators or literal types change how every
+    // expression is parsed, they can't wait for their first use
+    bool eager = false;
+    std::vector<std::string> builtins;
+    std::vector<std::pair<std::string,std::string>> macros;
+};
+using ExtensionManifest = std::map<std::string,ExtensionManifestEntry>;
+
+static std::filesystem::path extension_manifest_path() {
+    return std::filesystem::path(CATCARE_CACHE_PATH) / "extensions.manifest";
+}
+
+static ExtensionManifest read_extension_manifest() {
+    ExtensionManifest manifest;
+    BinaryReader reader = BinaryReader::from_file(extension_manifest_path());
+    // whether an extension loads at all depends on the interpreter's layout
+    if(reader.str() != "CCEM" || reader.u64() != carescript::extension_layout()) return manifest;
+    std::uint32_t count = reader.u32();
+    for(std::uint32_t i = 0; i < count && reader.good; ++i) {
+        std::string path = reader.str();
+        ExtensionManifestEntry entry;
+        entry.time = reader.u64();
+        entry.size = reader.u64();
+        entry.eager = reader.u32();
+        std::uint32_t builtins = reader.u32();
+        for(std::uint32_t j = 0; j < builtins && reader.good; ++j)
+            entry.builtins.push_back(reader.str());
+        std::uint32_t macros = reader.u32();
+        for(std::uint32_t j = 0; j < macros && reader.good; ++j) {
+            std::string name = reader.str();
+            entry.macros.push_back({name,reader.str()});
+        }
+        manifest[path] = entry;
+    }
+    if(!reader.good) return {};
+    return manifest;
+}
+
+static void write_extension_manifest(const ExtensionManifest& manifest) {
+    BinaryWriter writer;
+    writer.str("CCEM").u64(carescript::extension_layout()).u32(manifest.size());
+    for(const auto& [path,entry] : manifest) {
+        writer.str(path).u64(entry.time).u64(entry.size).u32(entry.eager);
+        writer.u32(entry.builtins.size());
+        for(const auto& i : entry.builtins) writer.str(i);
+        writer.u32(entry.macros.size());
+        for(const auto& i : entry.macros) writer.str(i.first).str(i.second);
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(extension_manifest_path().parent_path(),ec);
+    writer.to_file(extension_manifest_path());
+}
+
+// opens the extension once to find out what it provides
+static ExtensionManifestEntry inspect_extension(const std::string& path) {
+    ExtensionManifestEntry entry;
+    carescript::ExtensionHandle ext = carescript::get_ext(path);
+    if(ext.descriptor) {
+        const carescript::ExtensionDescriptorV1& d = *ext.descriptor;
+        if(d.capabilities & carescript::CARESCRIPT_HAS_BUILTINS) {
+            for(std::size_t i = 0; i < d.builtin_count; ++i) entry.builtins.push_back(d.builtins[i].name);
+        }
+        if(d.capabilities & carescript::CARESCRIPT_HAS_MACROS) {
+            for(std::size_t i = 0; i < d.macro_count; ++i) entry.macros.push_back({d.macros[i].name,d.macros[i].replacement});
+        }
+        entry.eager = d.capabilities & (carescript::CARESCRIPT_HAS_OPERATORS | carescript::CARESCRIPT_HAS_TYPES);
+    }
+    else if(ext.legacy) {
+        for(const auto& i : ext.legacy->get_builtins()) entry.builtins.push_back(i.first);
+        for(const auto& i : ext.legacy->get_macros()) entry.macros.push_back(i);
+        entry.eager = !ext.legacy->get_operators().empty() || !ext.legacy->get_types().empty();
+    }
+    return entry;
+}
+
+// extensions are only opened once a script uses one of their builtins,
+// what they provide is remembered in the extension manifest between runs
 void load_extensions(carescript::Interpreter& interp) {
     if(arg_settings::no_config) return;
-    for(auto i : std::filesystem::recursive_directory_iterator(CATCARE_EXTENSION_PATH)) {
-        if(i.is_directory()) continue;
-        carescript::bake_extension(i.path().string(),interp.settings);
+    ExtensionManifest old_manifest = read_extension_manifest();
+    ExtensionManifest manifest;
+    bool changed = false;
+
+    std::error_code ec;
+    for(std::filesystem::recursive_directory_iterator it(CATCARE_EXTENSION_PATH,ec), end; !ec && it != end; it.increment(ec)) {
+        if(it->is_directory(ec)) continue;
+        std::string path = it->path().string();
+        std::uint64_t time = it->last_write_time(ec).time_since_epoch().count();
+        std::uint64_t size = it->file_size(ec);
+
+        auto found = old_manifest.find(path);
+        if(found != old_manifest.end() && found->second.time == time && found->second.size == size) {
+            manifest[path] = found->second;
+            continue;
+        }
+        manifest[path] = inspect_extension(path);
+        manifest[path].time = time;
+        manifest[path].size = size;
+        changed = true;
     }
+    if(changed || manifest.size() != old_manifest.size()) write_extension_manifest(manifest);
+
+    auto providers = std::make_shared<std::unordered_map<std::string,std::string>>();
+    for(const auto& [path,entry] : manifest) {
+        if(entry.eager) {
+            carescript::bake_extension(path,interp.settings);
+            continue;
+        }
+        for(const auto& i : entry.builtins) (*providers)[i] = path;
+        interp.script_macros.insert(entry.macros.begin(),entry.macros.end());
+    }
+    if(providers->empty()) return;
+
+    interp.resolver = [providers](const std::string& name, carescript::Interpreter& interp) {
+        auto found = providers->find(name);
+        if(found == providers->end()) return false;
+        return carescript::bake_extension(found->second,interp.settings);
+    };
+}
+
+const carescript::InterpreterState& script_prototype() {
+    static const carescript::InterpreterState prototype = []() {
+        carescript::Interpreter interp;
+        carescript::bake_extension(get_extension(),interp.settings);
+        load_extensions(interp);
+        return carescript::InterpreterState(interp);
+    }();
+    return prototype;
 }
 
 IniDictionary extract_configs(IniFile file) {
@@ -150,6 +285,8 @@ IniDictionary extract_configs(IniFile file) {
         ret["dependencies"] = file.get("dependencies","Download");
     if(file.has("scripts","Download"))
         ret["scripts"] = file.get("scripts","Download");
+    if(file.has("independent_scripts","Download"))
+        ret["independent_scripts"] = file.get("independent_scripts","Download");
     if(file.has("description","Info"))
         ret["description"] = file.get("description","Info");
     if(file.has("tags","Info"))
@@ -160,6 +297,10 @@ IniDictionary extract_configs(IniFile file) {
         ret["license"] = file.get("license","Info");
     if(file.has("documentation","Info"))
         ret["documentation"] = file.get("documentation","Info");
+    if(file.has("hashes","Download"))
+        ret["hashes"] = file.get("hashes","Download");
+    if(file.has("archive","Download"))
+        ret["archive"] = file.get("archive","Download");
 
     return ret;
 }
@@ -177,11 +318,14 @@ std::string config_healthcare(IniDictionary conf) {
     if(conf.count("dependencies") != 0 && conf["dependencies"].get_type() != IniType::List) return "\"dependencies\" must be a list!";
     if(conf.count("version") != 0 && conf["version"].get_type() != IniType::String) return "\"version\" must be a string!";
     if(conf.count("scripts") != 0 && conf["scripts"].get_type() != IniType::List) return "\"scripts\" must be a list!";
+    if(conf.count("independent_scripts") != 0 && conf["independent_scripts"].get_type() != IniType::List) return "\"independent_scripts\" must be a list!";
     if(conf.count("description") != 0 && conf["description"].get_type() != IniType::String) return "\"description\" must be a string!";
     if(conf.count("tags") != 0 && conf["tags"].get_type() != IniType::List) return "\"tags\" must be a list!";
     if(conf.count("authors") != 0 && conf["authors"].get_type() != IniType::List) return "\"authors\" must be a list!";
     if(conf.count("license") != 0 && conf["license"].get_type() != IniType::String) return "\"license\" must be a string!";
     if(conf.count("documentation") != 0 && conf["documentation"].get_type() != IniType::String) return "\"documentation\" must be a string!";
+    if(conf.count("hashes") != 0 && conf["hashes"].get_type() != IniType::List) return "\"hashes\" must be a list!";
+    if(conf.count("archive") != 0 && conf["archive"].get_type() != IniType::String) return "\"archive\" must be a string!";
     
     return "";
 }
@@ -198,6 +342,171 @@ void make_register() {
     }
 }
 
+// changes to the register and the dependency list collected while
+// several projects install at once
+struct _RegisterTransaction {
+    std::mutex mutex;
+    // name -> url
+    std::map<std::string,std::string> installed;
+    std::vector<std::string> dependencies;
+    // url -> result of its install, once it is done
+    std::map<std::string,std::shared_future<std::string>> claimed;
+    std::map<std::string,std::promise<std::string>> pending;
+    // name -> where the project installed before lives meanwhile, "" if none
+    std::map<std::string,std::string> replaced;
+    std::map<std::string,LockEntry> locked;
+};
+static std::unique_ptr<_RegisterTransaction> register_transaction;
+
+// replaces path only once the new content is complete
+static void write_atomic(IniFile& file, std::string path) {
+    std::string tmp = path + ".tmp";
+    file.to_file(tmp);
+    std::error_code ec;
+    std::filesystem::rename(tmp,path,ec);
+    if(ec) std::filesystem::remove(tmp,ec);
+}
+
+std::string hash_file(const std::string& path) {
+    std::ifstream ifs(path,std::ios::binary);
+    std::stringstream ss;
+    ss << ifs.rdbuf();
+    return sha256(ss.str());
+}
+
+// every entry is "<sha256>:<path>", the hash never contains a ':'
+std::map<std::string,std::string> parse_file_hashes(IniList list) {
+    std::map<std::string,std::string> ret;
+    for(auto i : list) {
+        if(i.get_type() != IniType::String) continue;
+        std::string f = (std::string)i;
+        size_t sep = f.find(':');
+        if(sep == std::string::npos) continue;
+        ret[f.substr(sep + 1)] = f.substr(0,sep);
+    }
+    return ret;
+}
+
+IniList make_file_hashes(const std::map<std::string,std::string>& hashes) {
+    IniList ret;
+    for(const auto& [path,hash] : hashes) {
+        IniElement elm = hash + ":" + path;
+        ret.push_back(elm);
+    }
+    return ret;
+}
+
+static void write_lockfile(const std::map<std::string,LockEntry>& lock) {
+    IniFile file;
+    file.sections.push_back(IniSection("Main"));
+    for(const auto& [name,entry] : lock) {
+        IniList files = make_file_hashes(entry.files);
+        file.set("url",entry.url,name);
+        // inipp can't read back empty strings
+        if(entry.version != "") file.set("version",entry.version,name);
+        file.set("files",files,name);
+    }
+    write_atomic(file,CATCARE_LOCK_FILE);
+}
+
+void begin_register_transaction() {
+    make_register();
+    if(!arg_settings::global) make_checklist();
+    register_transaction = std::make_unique<_RegisterTransaction>();
+}
+
+void commit_register_transaction() {
+    if(!register_transaction) return;
+    std::unique_ptr<_RegisterTransaction> transaction = std::move(register_transaction);
+
+    IniFile reg = IniFile::from_file(CATCARE_ROOT + CATCARE_DIRSLASH CATCARE_REGISTERNAME);
+    IniDictionary l = reg.get("installed").to_dictionary();
+    for(const auto& [name,url] : transaction->installed) l[name] = url;
+    reg.set("installed",l);
+    write_atomic(reg,CATCARE_ROOT + CATCARE_DIRSLASH CATCARE_REGISTERNAME);
+
+    for(const auto& i : transaction->replaced) {
+        std::error_code ec;
+        if(i.second != "") std::filesystem::remove_all(i.second,ec);
+    }
+
+    if(!transaction->locked.empty()) {
+        std::map<std::string,LockEntry> lock = read_lockfile();
+        for(const auto& [name,entry] : transaction->locked) lock[name] = entry;
+        write_lockfile(lock);
+    }
+
+    if(arg_settings::global || transaction->dependencies.empty()) return;
+    IniFile checklist = IniFile::from_file(CATCARE_CHECKLISTNAME);
+    IniList deps = checklist.get("dependencies","Download");
+    for(const auto& i : transaction->dependencies) {
+        if(is_dependency(i)) continue;
+        IniElement elm = i;
+        deps.push_back(elm);
+    }
+    checklist.set("dependencies",deps,"Download");
+    write_atomic(checklist,CATCARE_CHECKLISTNAME);
+}
+
+void rollback_register_transaction() {
+    if(!register_transaction) return;
+    std::unique_ptr<_RegisterTransaction> transaction = std::move(register_transaction);
+    std::error_code ec;
+    for(const auto& i : transaction->installed) {
+        std::filesystem::remove_all(CATCARE_ROOT + CATCARE_DIRSLASH + i.first,ec);
+    }
+    // projects that were reinstalled get their previous files back
+    for(const auto& [name,backup] : transaction->replaced) {
+        std::filesystem::remove_all(CATCARE_ROOT + CATCARE_DIRSLASH + name,ec);
+        if(backup != "") std::filesystem::rename(backup,CATCARE_ROOT + CATCARE_DIRSLASH + name,ec);
+    }
+}
+
+bool claim_install(std::string url, std::string& error, bool wait) {
+    if(!register_transaction) return true;
+    std::shared_future<std::string> result;
+    {
+        std::lock_guard<std::mutex> lock(register_transaction->mutex);
+        auto found = register_transaction->claimed.find(url);
+        if(found == register_transaction->claimed.end()) {
+            auto& promise = register_transaction->pending[url];
+            register_transaction->claimed[url] = promise.get_future().share();
+            return true;
+        }
+        result = found->second;
+    }
+    if(wait) error = result.get();
+    return false;
+}
+
+void finish_install(std::string url, std::string error) {
+    if(!register_transaction) return;
+    std::lock_guard<std::mutex> lock(register_transaction->mutex);
+    auto found = register_transaction->pending.find(url);
+    if(found == register_transaction->pending.end()) return;
+    found->second.set_value(error);
+    register_transaction->pending.erase(found);
+}
+
+void replace_project(std::string name) {
+    std::string path = CATCARE_ROOT + CATCARE_DIRSLASH + name;
+    std::error_code ec;
+    if(register_transaction) {
+        std::lock_guard<std::mutex> lock(register_transaction->mutex);
+        if(register_transaction->replaced.count(name) == 0) {
+            std::string backup = "";
+            if(std::filesystem::exists(path,ec)) {
+                backup = CATCARE_ROOT + CATCARE_DIRSLASH + "__backup_" + name;
+                std::filesystem::remove_all(backup,ec);
+                std::filesystem::rename(path,backup,ec);
+                if(ec) backup = "";
+            }
+            register_transaction->replaced[name] = backup;
+        }
+    }
+    std::filesystem::remove_all(path,ec);
+}
+
 IniDictionary get_register() {
     make_register();
     IniFile reg = IniFile::from_file(CATCARE_ROOT + CATCARE_DIRSLASH CATCARE_REGISTERNAME);
@@ -205,6 +514,12 @@ IniDictionary get_register() {
 }
 
 bool installed(std::string name) {
+    if(register_transaction) {
+        std::lock_guard<std::mutex> lock(register_transaction->mutex);
+        for(const auto& i : register_transaction->installed) {
+            if(i.first == name || i.second == name) return true;
+        }
+    }
     IniDictionary lst = get_register();
     for(auto i : lst) {
         if((std::string)i.first == name || (std::string)i.second == name) return true;
@@ -215,6 +530,11 @@ bool installed(std::string name) {
 void add_to_register(std::string url, std::string name) {
     if(installed(url)) { return; }
     name = to_lowercase(name);
+    if(register_transaction) {
+        std::lock_guard<std::mutex> lock(register_transaction->mutex);
+        register_transaction->installed[name] = url;
+        return;
+    }
     IniFile reg = IniFile::from_file(CATCARE_ROOT + CATCARE_DIRSLASH CATCARE_REGISTERNAME);
     IniDictionary l = reg.get("installed").to_dictionary();
     l[name] = url;
@@ -231,10 +551,16 @@ void remove_from_register(std::string name) {
     d.erase(name);
     reg.set("installed",d);
     reg.to_file(CATCARE_ROOT + CATCARE_DIRSLASH CATCARE_REGISTERNAME);
+    unlock_project(name);
 }
 
 bool is_dependency(std::string url) {
     if(arg_settings::global) return false;
+    if(register_transaction) {
+        std::lock_guard<std::mutex> lock(register_transaction->mutex);
+        auto& deps = register_transaction->dependencies;
+        if(std::find(deps.begin(),deps.end(),url) != deps.end()) return true;
+    }
     IniList lst = get_dependencylist();
     for(auto i : lst) {
         if(i.get_type() == IniType::String && url == (std::string)i) {
@@ -247,6 +573,11 @@ bool is_dependency(std::string url) {
 void add_to_dependencylist(std::string url) {
     if(arg_settings::global) return;
     if(is_dependency(url)) return;
+    if(register_transaction) {
+        std::lock_guard<std::mutex> lock(register_transaction->mutex);
+        register_transaction->dependencies.push_back(url);
+        return;
+    }
     IniFile reg = IniFile::from_file(CATCARE_CHECKLISTNAME);
     IniList l = reg.get("dependencies","Download");
     IniElement elm = url;
@@ -278,6 +609,70 @@ std::string url2name(std::string url) {
     return "";
 }
 
+std::map<std::string,LockEntry> read_lockfile() {
+    std::map<std::string,LockEntry> ret;
+    if(!std::filesystem::exists(CATCARE_LOCK_FILE)) return ret;
+    IniFile file = IniFile::from_file(CATCARE_LOCK_FILE);
+    if(!file) return ret;
+
+    for(auto& section : file.sections) {
+        if(section.name == "Main" || !section.has("url")) continue;
+        LockEntry& entry = ret[section.name];
+        entry.url = (std::string)section["url"];
+        if(section.has("version")) entry.version = (std::string)section["version"];
+        if(section.has("files")) entry.files = parse_file_hashes(section["files"].to_list());
+    }
+    return ret;
+}
+
+void lock_project(std::string url, std::string name, std::string version) {
+    name = to_lowercase(name);
+    LockEntry entry;
+    entry.url = url;
+    entry.version = version;
+
+    std::filesystem::path root = CATCARE_ROOT + CATCARE_DIRSLASH + name;
+    std::error_code ec;
+    for(auto it = std::filesystem::recursive_directory_iterator(root,ec); !ec && it != std::filesystem::recursive_directory_iterator(); it.increment(ec)) {
+        // the link back to catpkgs belongs to every project
+        if(it->is_symlink()) {
+            it.disable_recursion_pending();
+            continue;
+        }
+        if(!it->is_regular_file()) continue;
+        entry.files[std::filesystem::relative(it->path(),root).generic_string()] = hash_file(it->path().string());
+    }
+
+    if(register_transaction) {
+        std::lock_guard<std::mutex> lock(register_transaction->mutex);
+        register_transaction->locked[name] = entry;
+        return;
+    }
+    std::map<std::string,LockEntry> lock = read_lockfile();
+    lock[name] = entry;
+    write_lockfile(lock);
+}
+
+void unlock_project(std::string name) {
+    std::map<std::string,LockEntry> lock = read_lockfile();
+    for(auto it = lock.begin(); it != lock.end(); ++it) {
+        if(it->first == name || it->second.url == name) {
+            lock.erase(it);
+            write_lockfile(lock);
+            return;
+        }
+    }
+}
+
+bool matches_lock(const LockEntry& entry, std::string name) {
+    if(entry.files.empty()) return false;
+    for(const auto& [path,hash] : entry.files) {
+        std::string file = CATCARE_ROOT + CATCARE_DIRSLASH + name + CATCARE_DIRSLASH + path;
+        if(!std::filesystem::is_regular_file(file) || hash_file(file) != hash) return false;
+    }
+    return true;
+}
+
 IniList get_dependencylist() {
     IniFile reg = IniFile::from_file(CATCARE_CHECKLISTNAME);
     return reg.get("dependencies","Download").to_list();
@@ -301,6 +696,7 @@ files = [] # append files manually or use `catcare add <file>`
 # optional
 dependencies = [] # append manually and sync or use `catcare get <user>/<project>`
 scripts = [] 
+independent_scripts = [] # scripts that may run in parallel to each other
 
 )");
     }
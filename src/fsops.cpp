@@ -0,0 +1,209 @@
+#include "../inc/fsops.hpp"
+#include "../inc/threadpool.hpp"
+
+#include <future>
+
+#ifdef __linux__
+# include <fcntl.h>
+# include <unistd.h>
+# include <sys/ioctl.h>
+# include <sys/stat.h>
+# include <linux/fs.h>
+#endif
+
+namespace fs = std::filesystem;
+
+bool glob_match(const std::string& pattern, const std::string& name) {
+    size_t p = 0, n = 0;
+    size_t star = std::string::npos, resume = 0;
+    while(n < name.size()) {
+        if(p < pattern.size() && (pattern[p] == '?' || pattern[p] == name[n])) {
+            ++p;
+            ++n;
+        }
+        else if(p < pattern.size() && pattern[p] == '*') {
+            star = p++;
+            resume = n;
+        }
+        else if(star != std::string::npos) {
+            p = star + 1;
+            n = ++resume;
+        }
+        else return false;
+    }
+    while(p < pattern.size() && pattern[p] == '*') ++p;
+    return p == pattern.size();
+}
+
+static bool has_wildcard(const std::string& component) {
+    return component.find_first_of("*?") != std::string::npos;
+}
+
+GlobWalker::GlobWalker(std::string pattern) {
+    fs::path root;
+    if(!pattern.empty() && pattern[0] == '/') root = "/";
+    std::string current;
+    for(char c : pattern) {
+        if(c == '/') {
+            if(!current.empty()) components.push_back(current);
+            current.clear();
+        }
+        else current += c;
+    }
+    if(!current.empty()) components.push_back(current);
+    if(!components.empty()) enter(root,0);
+}
+
+// queues the work for matching components[component...] inside of dir
+void GlobWalker::enter(const fs::path& dir, size_t component) {
+    std::error_code ec;
+    if(component == components.size()) {
+        matches.push_back(dir);
+        return;
+    }
+    const std::string& pattern = components[component];
+    if(pattern == "**") {
+        enter(dir,component + 1);
+    }
+    else if(!has_wildcard(pattern)) {
+        fs::path next = dir / pattern;
+        if(component + 1 == components.size() ? fs::exists(next,ec) : fs::is_directory(next,ec))
+            enter(next,component + 1);
+        return;
+    }
+    fs::directory_iterator it(dir.empty() ? "." : dir,ec);
+    if(!ec) levels.push_back({dir,component,it});
+}
+
+bool GlobWalker::next(fs::path& path) {
+    while(matches.empty() && !levels.empty()) {
+        Level& level = levels.back();
+        if(level.it == fs::directory_iterator()) {
+            levels.pop_back();
+            continue;
+        }
+        fs::directory_entry entry = *level.it;
+        std::error_code ec;
+        level.it.increment(ec);
+        if(ec) level.it = fs::directory_iterator();
+
+        // level may dangle once enter() pushed a new one
+        fs::path dir = level.dir;
+        size_t component = level.component;
+        std::string name = entry.path().filename().string();
+        // like a shell, wildcards don't match hidden files
+        if(name[0] == '.' && components[component][0] != '.') continue;
+        if(components[component] == "**") {
+            if(entry.is_directory(ec) && !entry.is_symlink(ec))
+                enter(dir / name,component);
+        }
+        else if(glob_match(components[component],name)) {
+            if(component + 1 == components.size() || entry.is_directory(ec))
+                enter(dir / name,component + 1);
+        }
+    }
+    if(matches.empty()) return false;
+    path = matches.front();
+    matches.pop_front();
+    return true;
+}
+
+std::error_code copy_file_fast(const fs::path& from, const fs::path& to) {
+    std::error_code ec;
+#ifdef __linux__
+    int in = open(from.c_str(),O_RDONLY | O_CLOEXEC);
+    if(in < 0) return std::error_code(errno,std::generic_category());
+    struct stat st;
+    if(fstat(in,&st) != 0) {
+        ec = std::error_code(errno,std::generic_category());
+        close(in);
+        return ec;
+    }
+    int out = open(to.c_str(),O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC,st.st_mode & 07777);
+    if(out < 0) {
+        ec = std::error_code(errno,std::generic_category());
+        close(in);
+        return ec;
+    }
+
+    bool done = ioctl(out,FICLONE,in) == 0;
+    off_t left = st.st_size;
+    while(!done && left > 0) {
+        ssize_t copied = copy_file_range(in,nullptr,out,nullptr,left,0);
+        if(copied <= 0) break;
+        left -= copied;
+    }
+    done = done || left == 0;
+    close(in);
+    close(out);
+    if(done) return ec;
+#endif
+    // file systems without copy_file_range support
+    fs::copy_file(from,to,fs::copy_options::overwrite_existing,ec);
+    return ec;
+}
+
+std::error_code copy_path(const fs::path& from, const fs::path& to) {
+    std::error_code ec;
+    if(fs::is_symlink(from,ec)) {
+        fs::remove(to,ec);
+        fs::copy_symlink(from,to,ec);
+        return ec;
+    }
+    if(!fs::is_directory(from,ec)) {
+        if(!fs::exists(from,ec)) return std::make_error_code(std::errc::no_such_file_or_directory);
+        return copy_file_fast(from,to);
+    }
+
+    fs::create_directories(to,ec);
+    if(ec) return ec;
+    for(fs::recursive_directory_iterator it(from,ec), end; !ec && it != end; it.increment(ec)) {
+        fs::path target = to / fs::relative(it->path(),from);
+        if(it->is_symlink(ec)) {
+            fs::remove(target,ec);
+            fs::copy_symlink(it->path(),target,ec);
+        }
+        else if(it->is_directory(ec)) fs::create_directories(target,ec);
+        else ec = copy_file_fast(it->path(),target);
+        if(ec) return ec;
+    }
+    return ec;
+}
+
+std::error_code move_path(const fs::path& from, const fs::path& to) {
+    std::error_code ec;
+    fs::rename(from,to,ec);
+    if(ec != std::errc::cross_device_link) return ec;
+
+    ec = copy_path(from,to);
+    if(ec) return ec;
+    return remove_path(from);
+}
+
+std::error_code remove_path(const fs::path& path) {
+    std::error_code ec;
+    if(fs::remove_all(path,ec) == 0 && !ec)
+        ec = std::make_error_code(std::errc::no_such_file_or_directory);
+    return ec;
+}
+
+std::vector<std::pair<fs::path,std::error_code>> bulk_file_operation(FileOperation op, const std::vector<fs::path>& paths, const fs::path& dest) {
+    std::vector<std::future<std::error_code>> results;
+    results.reserve(paths.size());
+    for(const auto& i : paths) {
+        results.push_back(worker_pool().submit([op,i,&dest]() {
+            switch(op) {
+            case FileOperation::COPY: return copy_path(i,dest / i.filename());
+            case FileOperation::MOVE: return move_path(i,dest / i.filename());
+            default: return remove_path(i);
+            }
+        }));
+    }
+
+    std::vector<std::pair<fs::path,std::error_code>> failed;
+    for(size_t i = 0; i < results.size(); ++i) {
+        std::error_code ec = results[i].get();
+        if(ec) failed.push_back({paths[i],ec});
+    }
+    return failed;
+}
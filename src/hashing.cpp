@@ -0,0 +1,84 @@
+#include "../inc/hashing.hpp"
+
+#include <cstring>
+
+std::uint64_t fnv1a(const std::string& data, std::uint64_t seed) {
+    std::uint64_t hash = seed;
+    for(unsigned char c : data) {
+        hash ^= c;
+        hash *= 0x100000001b3ULL;
+    }
+    return hash;
+}
+
+std::string to_hex(std::uint64_t value) {
+    static const char* digits = "0123456789abcdef";
+    std::string ret(16,'0');
+    for(int i = 15; i >= 0; --i) {
+        ret[i] = digits[value & 0xf];
+        value >>= 4;
+    }
+    return ret;
+}
+
+static std::uint32_t rotr(std::uint32_t x, int n) {
+    return (x >> n) | (x << (32 - n));
+}
+
+std::string sha256(const std::string& data) {
+    static const std::uint32_t k[64] = {
+        0x428a2f98,0x71374491,0xb5c0fbcf,0xe9b5dba5,0x3956c25b,0x59f111f1,0x923f82a4,0xab1c5ed5,
+        0xd807aa98,0x12835b01,0x243185be,0x550c7dc3,0x72be5d74,0x80deb1fe,0x9bdc06a7,0xc19bf174,
+        0xe49b69c1,0xefbe4786,0x0fc19dc6,0x240ca1cc,0x2de92c6f,0x4a7484aa,0x5cb0a9dc,0x76f988da,
+        0x983e5152,0xa831c66d,0xb00327c8,0xbf597fc7,0xc6e00bf3,0xd5a79147,0x06ca6351,0x14292967,
+        0x27b70a85,0x2e1b2138,0x4d2c6dfc,0x53380d13,0x650a7354,0x766a0abb,0x81c2c92e,0x92722c85,
+        0xa2bfe8a1,0xa81a664b,0xc24b8b70,0xc76c51a3,0xd192e819,0xd6990624,0xf40e3585,0x106aa070,
+        0x19a4c116,0x1e376c08,0x2748774c,0x34b0bcb5,0x391c0cb3,0x4ed8aa4a,0x5b9cca4f,0x682e6ff3,
+        0x748f82ee,0x78a5636f,0x84c87814,0x8cc70208,0x90befffa,0xa4506ceb,0xbef9a3f7,0xc67178f2
+    };
+    std::uint32_t h[8] = {
+        0x6a09e667,0xbb67ae85,0x3c6ef372,0xa54ff53a,0x510e527f,0x9b05688c,0x1f83d9ab,0x5be0cd19
+    };
+
+    // padding: 0x80, zeros up to 56 mod 64, then the bit length big endian
+    std::string msg = data;
+    std::uint64_t bits = (std::uint64_t)data.size() * 8;
+    msg += (char)0x80;
+    while(msg.size() % 64 != 56) msg += (char)0;
+    for(int i = 7; i >= 0; --i) msg += (char)((bits >> (i * 8)) & 0xff);
+
+    for(size_t chunk = 0; chunk < msg.size(); chunk += 64) {
+        std::uint32_t w[64];
+        for(int i = 0; i < 16; ++i) {
+            const unsigned char* p = (const unsigned char*)msg.data() + chunk + i * 4;
+            w[i] = ((std::uint32_t)p[0] << 24) | ((std::uint32_t)p[1] << 16) | ((std::uint32_t)p[2] << 8) | p[3];
+        }
+        for(int i = 16; i < 64; ++i) {
+            std::uint32_t s0 = rotr(w[i-15],7) ^ rotr(w[i-15],18) ^ (w[i-15] >> 3);
+            std::uint32_t s1 = rotr(w[i-2],17) ^ rotr(w[i-2],19) ^ (w[i-2] >> 10);
+            w[i] = w[i-16] + s0 + w[i-7] + s1;
+        }
+
+        std::uint32_t a[8];
+        std::memcpy(a,h,sizeof(h));
+        for(int i = 0; i < 64; ++i) {
+            std::uint32_t s1 = rotr(a[4],6) ^ rotr(a[4],11) ^ rotr(a[4],25);
+            std::uint32_t ch = (a[4] & a[5]) ^ (~a[4] & a[6]);
+            std::uint32_t t1 = a[7] + s1 + ch + k[i] + w[i];
+            std::uint32_t s0 = rotr(a[0],2) ^ rotr(a[0],13) ^ rotr(a[0],22);
+            std::uint32_t maj = (a[0] & a[1]) ^ (a[0] & a[2]) ^ (a[1] & a[2]);
+            std::uint32_t t2 = s0 + maj;
+            std::memmove(a + 1,a,7 * sizeof(std::uint32_t));
+            a[4] += t1;
+            a[0] = t1 + t2;
+        }
+        for(int i = 0; i < 8; ++i) h[i] += a[i];
+    }
+
+    static const char* digits = "0123456789abcdef";
+    std::string ret;
+    for(int i = 0; i < 8; ++i) {
+        for(int j = 28; j >= 0; j -= 4) ret += digits[(h[i] >> j) & 0xf];
+    }
+    return ret;
+}
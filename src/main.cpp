@@ -3,17 +3,28 @@
 #include "../mods/ArgParser/ArgParser.h"
 #include "../carescript/carescript-api.hpp"
 #include "../inc/catcaretaker-ccs-extension.hpp"
+#include "../inc/scriptcache.hpp"
+#include "../inc/scriptrunner.hpp"
+#include "../inc/threadpool.hpp"
+#include "../inc/transfer.hpp"
+
+#include <set>
 
 #include <time.h>
 
+#ifdef __linux__
+#include <unistd.h>
+#endif
+
 void print_help() {
     std::cout << "## CatCaretaker\n"
             << "A configurable helper to reuse already made work fast and efficient from github.\n\n"
             << " catcare <option> [arguments] [flags]\n\n"
             << "option :=\n"
-            << "   download|get <code>          :  downloads and sets up the project.\n"
+            << "   download|get <code...|->     :  downloads and sets up the projects, - reads them from stdin.\n"
             << "   erase|remove [.all|<proj>]   :  removes an installed project.\n"
             << "   add <path>                   :  add a file to the downloadlist\n"
+            << "   hash                         :  records the hashes of the listed files for delta updates.\n"
             << "   cleanup                      :  removes all installed projects.\n"
             << "   info <install>               :  shows infos about the selected project.\n"
             << "   this                         :  shwos infos about the current project.\n"
@@ -28,11 +39,13 @@ void print_help() {
             << "   template [list]              :  create a template file.\n"       
             << "   blacklist [append|pop|show]  :  blacklsit certain projects.\n"  
             << "   macro <macro> <args...>      :  runs a macro file. (.help|.list for help)\n"
-            << "   sync                         :  reinstalls all the dependencies of the current project.\n\n"
+            << "   sync                         :  adds, updates and removes dependencies until they match the checklist.\n\n"
             << "flags := \n"
             << "   --help|-h                  :  prints this and exits.\n"
             << "   --global|-g                :  installs into the global installation directory.\n"
             << "   --no-config                :  don't create a config directory.\n"
+            << "   --profile-scripts          :  times the executed scripts and writes catcare_profile.folded.\n"
+            << "   --dry-run                  :  sync only prints what it would change.\n"
             << "   --silent|-s                :  prevents info and error messages.\n\n"
             << "By LabRiceCat (c) 2023\n"
             << "Repository: https://github.com/LabRiceCat/catcaretaker\n";
@@ -77,6 +90,15 @@ void print_config(IniDictionary config) {
         }
         std::cout << "\n";
     }
+    if(config.count("independent_scripts") != 0 && config["independent_scripts"].to_list().size() != 0) {
+       std::cout << "Independent scripts: \n";
+        IniList list = config["independent_scripts"].to_list();
+        for(size_t i = 0; i < list.size(); ++i) {
+            if(i != 0) std::cout << ", ";
+            std::cout << (std::string)list[i];
+        }
+        std::cout << "\n";
+    }
     if(config.count("dependencies") != 0 && config["dependencies"].to_list().size() != 0) {
         std::cout << "Dependencies: \n";
         for(auto i : config["dependencies"].to_list()) {
@@ -106,6 +128,18 @@ void print_config(IniDictionary config) {
     }
 }
 
+void print_sync_plan(const SyncPlan& plan) {
+    if(plan.empty()) {
+        std::cout << "All dependencies are up to date!\n";
+        return;
+    }
+    for(auto& i : plan.add) std::cout << " + " << i.url << " (" << i.reason << ")\n";
+    for(auto& i : plan.update) std::cout << " ~ " << i.name << ": " << i.url << " (" << i.reason << ")\n";
+    for(auto& i : plan.remove) std::cout << " - " << i.name << ": " << i.url << " (" << i.reason << ")\n";
+    for(auto& i : plan.lock) std::cout << " = " << i.name << ": " << i.url << " (" << i.reason << ")\n";
+    std::cout << plan.add.size() << " to add, " << plan.update.size() << " to update, " << plan.remove.size() << " to remove, " << plan.lock.size() << " to lock, " << plan.keep.size() << " unchanged.\n";
+}
+
 // #define DEBUG
 
 // only_installed = 0 -> only already installed projects
@@ -151,10 +185,169 @@ UrlPackage ask_to_resolve(std::string inp, int only_installed = 0) {
     return urls[0];
 }
 
+// runs the pre embedds, downloads url and runs the attachments and post embedds
+static bool install_package(UrlPackage url) {
+    using namespace carescript;
+    std::string error;
+    bool dnl = true;
+    Interpreter emb_interpreter(script_prototype());
+    if(url.rule.embedded.size() != 0) print_message("INFO","Executing pre embedds...");
+    for(auto i : url.rule.embedded) {
+        dnl &= i.second != 2;
+        if(i.second != 1) {
+            emb_interpreter.pre_process(i.first).on_error([&](Interpreter& i) {
+                print_message("ERROR","in embed: " + i.error());
+            }).otherwise([&](Interpreter& i) {
+                for(auto j : url.rule.link.placeholders) {
+                    i.settings.variables[j] = new ScriptStringValue(url.pairs[j]);
+                }
+                std::string error = run_limited(i);
+                if(error != "") print_message("ERROR","in embed: " + error);
+            });
+        }
+    }
+    if(url.rule.embedded.size() != 0) print_message("INFO","Finished pre embedds!");
+    
+
+    if(url.rule.script_handle == 1 && dnl)
+        error = download_project(url.link,url.mirrors);
+
+    if(error != "") {
+        print_message("ERROR","Error while downloading project!\n-> " + error);
+        return false;
+    }
+    else {
+        if(!url.rule.scripts.empty() && option_or("parallel_attachments","false") == "true") {
+            print_message("INFO","Running attachments...");
+            std::vector<IsolatedScript> attachments;
+            for(auto i : url.rule.scripts) {
+                attachments.push_back({i,read_script(CATCARE_ATTACHMENT_PATH CATCARE_DIRSLASH + i),"attachment",{url.link}});
+            }
+            print_isolated(attachments,run_isolated(attachments),"Attachment");
+        }
+        else if(!url.rule.scripts.empty()) {
+            print_message("INFO","Running attachments...");
+            for(auto i : url.rule.scripts) {
+                Interpreter interp(script_prototype());
+                std::string src = read_script(CATCARE_ATTACHMENT_PATH CATCARE_DIRSLASH + i);
+                load_script(interp,src);
+                if(!interp) {
+                    print_message("ERROR","Attachment " + i + " by rule " + url.rule.name + ": \n  " + interp.error());
+                }
+                std::string error = run_limited(interp,"attachment",{url.link});
+                if(error != "") {
+                    print_message("ERROR","Attachment " + i + " by rule " + url.rule.name + ": \n  " + error);
+                }
+            }
+        }
+        if(url.rule.embedded.size() != 0) print_message("INFO","Executing post embedds...");
+        for(auto i : url.rule.embedded) {
+            if(i.second == 1) {
+                emb_interpreter.pre_process(i.first).on_error([&](Interpreter& i) {
+                    print_message("ERROR","in embed: " + i.error());
+                }).otherwise([](Interpreter& i) {
+                    std::string error = run_limited(i);
+                    if(error != "") print_message("ERROR","in embed: " + error);
+                });
+            }
+        }
+        if(url.rule.embedded.size() != 0) print_message("INFO","Executing post embedds...");
+        if(url.rule.script_handle == 0 && dnl)
+            error = download_project(url.link,url.mirrors);
+        if(error != "") {
+            print_message("ERROR","Error while downloading project!\n-> " + error);
+            return false;
+        }
+
+        print_message("RESULT","Successfully installed!");
+        if(!is_dependency(url.link)) {
+            add_to_dependencylist(url.link);
+        }
+    }
+    return true;
+}
+
+// whether scripts could ask the user something, answers come from stdin
+static bool can_prompt(bool stdin_read) {
+    if(stdin_read) return false;
+#ifdef __linux__
+    return isatty(STDIN_FILENO);
+#else
+    return true;
+#endif
+}
+
+// installs all specs together, "-" reads further specs from stdin
+// the register and the dependency list are only written if all succeed
+static bool install_packages(std::vector<std::string> specs) {
+    bool review = option_or("show_script_src","false") == "true";
+    bool stdin_read = std::find(specs.begin(),specs.end(),"-") != specs.end();
+    if(review && stdin_read) {
+        print_message("ERROR","show_script_src asks on stdin, which - already reads the projects from!");
+        return false;
+    }
+
+    std::vector<std::string> inputs;
+    for(auto i : specs) {
+        if(i != "-") {
+            inputs.push_back(to_lowercase(i));
+            continue;
+        }
+        std::string spec;
+        while(std::cin >> spec) inputs.push_back(to_lowercase(spec));
+    }
+    if(inputs.empty()) {
+        print_message("ERROR","No projects to install!");
+        return false;
+    }
+
+    // everything is resolved before anything is downloaded
+    std::vector<UrlPackage> packages;
+    std::set<std::string> links;
+    bool failed = false;
+    for(auto& i : resolve_batch(inputs)) {
+        if(i.ambiguous()) {
+            std::string candidates;
+            for(auto& j : i.candidates) candidates += "\n   " + j.rule.name + ": " + j.link;
+            print_message("ERROR","Ambiguous project " + i.spec + ", could be:" + candidates);
+            failed = true;
+        }
+        else if(!i.resolved()) {
+            print_message("ERROR","Can't resolve " + i.spec + " to any rules!");
+            failed = true;
+        }
+        else if(links.insert(i.candidates[0].link).second) {
+            packages.push_back(i.candidates[0]);
+        }
+    }
+    if(failed) return false;
+
+    begin_register_transaction();
+    std::vector<std::future<bool>> results;
+    {
+        // reviews and prompts of scripts would interleave, so installs
+        // that may ask something run one after another
+        size_t workers = review || can_prompt(stdin_read) ? 1 : std::min(packages.size(),transfer_engine().connections());
+        ThreadPool pool(workers);
+        for(auto& i : packages) {
+            results.push_back(pool.submit([&i]{ return install_package(i); }));
+        }
+    }
+    size_t installed = 0;
+    for(auto& i : results) installed += i.get();
+
+    if(installed != packages.size()) {
+        rollback_register_transaction();
+        print_message("ERROR",std::to_string(packages.size() - installed) + " of " + std::to_string(packages.size()) + " projects failed, nothing was installed!");
+        return false;
+    }
+    commit_register_transaction();
+    print_message("RESULT","Successfully installed " + std::to_string(installed) + " projects!");
+    return true;
+}
+
 int main(int argc,char** argv) {
     using namespace carescript;
-    Interpreter interpreter;
-    bake_extension(get_extension(),interpreter.settings);
 
     if(options.count("default_silent") > 0 && (options["default_silent"] == "1" || options["default_silent"] == "true")) {
         arg_settings::opt_silence = true;
@@ -178,6 +371,7 @@ int main(int argc,char** argv) {
         .addArg("browse",ARG_SET,{},0)
         .addArg("release",ARG_TAG,{},0)
         .addArg("add",ARG_SET,{},0)
+        .addArg("hash",ARG_TAG,{},0)
         .addArg("whatsnew",ARG_SET,{},0)
         .addArg("macro",ARG_SET,{},0)
         .addArg("template",ARG_SET,{},0)
@@ -191,6 +385,8 @@ int main(int argc,char** argv) {
         .addArg("--silent",ARG_TAG,{"-s"})
         .addArg("--global",ARG_TAG,{"-g"})
         .addArg("--no-config",ARG_TAG,{})
+        .addArg("--profile-scripts",ARG_TAG,{})
+        .addArg("--dry-run",ARG_TAG,{})
 #ifdef DEBUG
         .addArg("--debug",ARG_TAG,{"-d"})
 #endif
@@ -212,6 +408,12 @@ int main(int argc,char** argv) {
     arg_settings::opt_silence = pargs["--silent"];
     arg_settings::no_config = pargs["--no-config"];
     arg_settings::global = pargs["--global"];
+    arg_settings::profile_scripts = pargs["--profile-scripts"];
+    if(arg_settings::profile_scripts) {
+        // the profiler has to outlive the report
+        script_profiler();
+        std::atexit([](){ report_profile("catcare_profile.folded"); });
+    }
 
     if(!arg_settings::no_config) {
         std::string hcheck = healthcheck_localconf();
@@ -229,88 +431,20 @@ int main(int argc,char** argv) {
             return 1;
         }
         load_localconf();
-        load_extensions(interpreter);
     }
 
-    if((pargs("append") != "" || pargs("pop") != "" || pargs["show"]) && !pargs["blacklist"] || (pargs.has_bin() && pargs("macro") == "")) {
+    if((pargs("append") != "" || pargs("pop") != "" || pargs["show"]) && !pargs["blacklist"] || (pargs.has_bin() && pargs("macro") == "" && pargs("download") == "")) {
         print_help();
     }
     else if(pargs("download") != "") {
-        std::string error;
-        std::string project = pargs("download");
-        auto url = ask_to_resolve(project,2);
-        if(url.link == "") return 1;
-
-        bool dnl = true;
-        Interpreter emb_interpreter;
-        bake_extension(get_extension(),emb_interpreter.settings);
-        load_extensions(emb_interpreter);
-        if(url.rule.embedded.size() != 0) print_message("INFO","Executing pre embedds...");
-        for(auto i : url.rule.embedded) {
-            dnl &= i.second != 2;
-            if(i.second != 1) {
-                emb_interpreter.pre_process(i.first).on_error([&](Interpreter& i) {
-                    print_message("ERROR","in embed: " + i.error());
-                }).otherwise([&](Interpreter& i) {
-                    for(auto j : url.rule.link.placeholders) {
-                        i.settings.variables[j] = new ScriptStringValue(url.pairs[j]);
-                    }
-                    i.run().on_error([&](Interpreter& j) {
-                        print_message("ERROR","in embed: " + j.error());
-                    });
-                });
-            }
-        }
-        if(url.rule.embedded.size() != 0) print_message("INFO","Finished pre embedds!");
-        
-
-        if(url.rule.script_handle == 1 && dnl)
-            error = download_project(url.link);
-
-        if(error != "")
-            print_message("ERROR","Error while downloading project!\n-> " + error);
-        else {
-            if(!url.rule.scripts.empty()) {
-                print_message("INFO","Running attachments...");
-                for(auto i : url.rule.scripts) {
-                    Interpreter interp;
-                    bake_extension(get_extension(),interp.settings);
-                    load_extensions(interp);
-                    std::ifstream f(CATCARE_ATTACHMENT_PATH CATCARE_DIRSLASH + i);
-                    std::string src;
-                    while(f.good()) src += f.get();
-                    if(!src.empty()) src.pop_back();
-                    interp.pre_process(src);
-                    if(!interp) {
-                        print_message("ERROR","Attachment " + i + " by rule " + url.rule.name + ": \n  " + interp.error());
-                    }
-                    interp.run("attachment",url.link);
-                    if(!interp) {
-                        print_message("ERROR","Attachment " + i + " by rule " + url.rule.name + ": \n  " + interp.error());
-                    }
-                }
-            }
-            if(url.rule.embedded.size() != 0) print_message("INFO","Executing post embedds...");
-            for(auto i : url.rule.embedded) {
-                if(i.second == 1) {
-                    emb_interpreter.pre_process(i.first).on_error([&](Interpreter& i) {
-                        print_message("ERROR","in embed: " + i.error());
-                    }).otherwise([](Interpreter& i) {
-                        i.run().on_error([&](Interpreter& j) {
-                            print_message("ERROR","in embed: " + j.error());
-                        });
-                    });
-                }
-            }
-            if(url.rule.embedded.size() != 0) print_message("INFO","Executing post embedds...");
-            if(url.rule.script_handle == 0 && dnl)
-                error = download_project(url.link);
-
-            print_message("RESULT","Successfully installed!");
-            if(!is_dependency(url.link)) {
-                add_to_dependencylist(url.link);
-            }
+        std::vector<std::string> specs = {pargs("download")};
+        for(auto i : pargs.get_bin()) specs.push_back(i);
+        if(specs.size() > 1 || specs[0] == "-") {
+            return install_packages(specs) ? 0 : 1;
         }
+        auto url = ask_to_resolve(specs[0],2);
+        if(url.link == "") return 1;
+        if(!install_package(url)) return 1;
     }
     else if(pargs("erase") != "") {
         if(pargs("erase") == ".all") {
@@ -392,7 +526,19 @@ int main(int argc,char** argv) {
             << "default_silent  :  If true -> `--silent` will be enabled by default. (default: false)\n"
             << "clear_on_error  :  If true -> clears the downloading project if an error occurs. (default: true)\n"
             << "show_script_src :  If true -> open a little lookup when a new script gets executed. (default: false)\n"
-            << "no_scripts      :  If true -> stops all scripts from executing. (Warning: not recomended, default: false)\n";
+            << "no_scripts      :  If true -> stops all scripts from executing. (Warning: not recomended, default: false)\n"
+            << "script_cache    :  If true -> keeps pre processed scripts in the cache directory. (default: true)\n"
+            << "download_connections : Number of files downloaded at the same time. (default: 4)\n"
+            << "download_retries : How often a failed download is retried, it continues where it stopped. (default: 3)\n"
+            << "download_backoff : Milliseconds before the first retry, doubled for each further one. (default: 250)\n"
+            << "download_connect_timeout : Seconds to wait for a connection, 0 for curl's default. (default: 15)\n"
+            << "download_stall_timeout : Seconds a download may receive nothing before it's retried, 0 for no limit. (default: 30)\n"
+            << "parallel_attachments : If true -> runs the attachments of a rule at the same time. (default: false)\n"
+            << "script_max_instructions : Lines a package script may run before it's stopped, 0 for no limit. (default: 0)\n"
+            << "script_max_depth : How deep package scripts may nest calls, 0 for no limit. (default: 256)\n"
+            << "script_timeout  :  Seconds a package script may run before it's stopped, 0 for no limit (300 in the sandbox). (default: 0)\n"
+            << "script_sandbox  :  If true -> runs package scripts in a separate, resource limited process. Their variables and profile stay in there. (default: false)\n"
+            << "script_memory_limit : Megabytes a sandboxed script may use, 0 for no limit. (default: 0)\n";
 
         }
         else {
@@ -456,8 +602,9 @@ int main(int argc,char** argv) {
 
         CATGUIDE_HEADER();
         std::cout 
-        << "To download the newest version of each dependency run:\n"
+        << "To install missing, update outdated and remove unused dependencies run:\n"
         << " $ catcare sync\n"
+        << "Add --dry-run to only see what would change. Projects still matching `" CATCARE_LOCKNAME "` are kept.\n"
         << "You can also read the latest patch notes of a project by doing:\n"
         << " $ catcare whatsnew <project>\n"
         << "Note that this will only work if the target project contains a `" << CATCARE_RELEASES_FILE << "` !\n";
@@ -516,16 +663,17 @@ int main(int argc,char** argv) {
     }
     else if(pargs["sync"]) {
         print_message("DOWNLOAD","Syncronising the dependencies...");
-        IniList deps = get_dependencylist();
-        if(std::filesystem::exists(CATCARE_ROOT)) {
-            std::filesystem::remove_all(CATCARE_ROOT);
+        SyncPlan plan = plan_sync();
+        if(pargs["--dry-run"]) {
+            print_sync_plan(plan);
+            return 0;
         }
-        make_register();
-        for(auto i : deps) {
-            std::filesystem::remove_all(CATCARE_ROOT + CATCARE_DIRSLASH + (std::string)i);
-            remove_from_register((std::string)i);
+        if(plan.empty()) {
+            print_message("RESULT","All dependencies are up to date!");
+            return 0;
         }
-        download_dependencies(deps);
+        if(!apply_sync(plan)) return 1;
+        print_message("RESULT","Synchronised " + std::to_string(plan.add.size() + plan.update.size() + plan.remove.size() + plan.lock.size()) + " projects!");
     }
     else if(pargs("check") != "") {
         std::string proj = pargs("check");
@@ -559,7 +707,7 @@ int main(int argc,char** argv) {
             std::string inp;
             std::getline(std::cin,inp);
             if(inp == "Yes" || inp == "y" || inp == "Y" || inp == "yes") {
-                std::string error = download_project(url.link);
+                std::string error = download_project(url.link,url.mirrors);
                 if(error != "")
                     print_message("ERROR","Error downloading project!\n-> " + error);
                 else {
@@ -679,6 +827,25 @@ int main(int argc,char** argv) {
             std::cout << "File added! (New entries: " << added << ")\n";
         }
     }
+    else if(pargs["hash"]) {
+        make_checklist();
+        std::map<std::string,std::string> hashes;
+        for(auto i : get_filelist()) {
+            if(i.get_type() != IniType::String) continue;
+            std::string file = (std::string)i;
+            if(!file.empty() && file[0] == '!') file.erase(file.begin());
+            if(file.empty() || file[0] == '$' || file[0] == '#') continue;
+            if(!std::filesystem::is_regular_file(file)) {
+                print_message("ERROR","No such file: " + file);
+                return 1;
+            }
+            hashes[file] = hash_file(file);
+        }
+        IniFile f = IniFile::from_file(CATCARE_CHECKLISTNAME);
+        f.set("hashes",make_file_hashes(hashes),"Download");
+        f.to_file(CATCARE_CHECKLISTNAME);
+        print_message("RESULT","Hashed " + std::to_string(hashes.size()) + " files!");
+    }
     else if(pargs("whatsnew") != "") {
         std::string proj = pargs("whatsnew");
         auto url = ask_to_resolve(proj,2);
@@ -746,6 +913,9 @@ files = [] # append files manually or use `catcare add <file>`
 # optional
 dependencies = [] # append manually and sync or use `catcare get <user>/<project>`
 scripts = [] 
+independent_scripts = [] # scripts that may run in parallel to each other
+hashes = [] # lets updates fetch only changed files, fill with `catcare hash`
+# archive = "" # a .tar.gz (or .tar) holding the files, relative to the project or a full url
 )");
             print_message("INFO","Template successfully created as " CATCARE_CHECKLISTNAME);
         }
@@ -894,18 +1064,16 @@ RULE github;
             return 1;
         }
 
+        Interpreter interpreter(script_prototype());
         interpreter.settings.line = 1;
         ScriptArglist args;
         for(auto i : pargs.get_bin()) {
             args.push_back(ScriptVariable(i));
         }
         
-        std::string r;
-        std::ifstream ifile(CATCARE_MACRO_PATH CATCARE_DIRSLASH + macro + CATCARE_CARESCRIPT_EXT);
-        while(ifile.good()) r += ifile.get();
-        if(r != "") r.pop_back();
+        std::string r = read_script(CATCARE_MACRO_PATH CATCARE_DIRSLASH + macro + CATCARE_CARESCRIPT_EXT);
 
-        interpreter.pre_process(r).on_error([&](Interpreter& i) {
+        load_script(interpreter,r).on_error([&](Interpreter& i) {
             std::cout << "Error in macro: " << i.error() << "\n";
         });
         if(!interpreter) {
@@ -936,9 +1104,12 @@ RULE github;
             return 1;
         }
     
+        interpreter.profiler = script_profiler();
         interpreter.run("macro_call",args).on_error([](Interpreter& i){
             print_message("ERROR",i.error());
         });
+        // exit in a macro ends catcare with its status
+        if(interpreter.exit_code) return *interpreter.exit_code;
     }
     else if(pargs["this"]) {
         if(!std::filesystem::exists(CATCARE_CHECKLISTNAME)) {
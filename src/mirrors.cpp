@@ -0,0 +1,88 @@
+#include "../inc/mirrors.hpp"
+#include "../inc/network.hpp"
+#include "../inc/options.hpp"
+#include "../inc/serialize.hpp"
+
+#include <map>
+#include <mutex>
+#include <algorithm>
+
+// results fade by this factor with every new one of the same host
+#define CATCARE_MIRROR_DECAY 0.9
+// changes whenever the meaning of the stored statistics does
+#define CATCARE_MIRROR_MAGIC "CCM2"
+
+static std::mutex mirror_mutex;
+
+static std::filesystem::path mirror_stats_path() {
+    return std::filesystem::path(CATCARE_CACHE_PATH) / "mirrors.cache";
+}
+
+// loaded on first use, callers hold mirror_mutex
+static std::map<std::string,MirrorStats>& mirror_stats() {
+    static std::map<std::string,MirrorStats> stats = []() {
+        std::map<std::string,MirrorStats> ret;
+        if(arg_settings::no_config) return ret;
+        BinaryReader reader = BinaryReader::from_file(mirror_stats_path());
+        if(reader.str() != CATCARE_MIRROR_MAGIC) return ret;
+        std::uint32_t count = reader.u32();
+        for(std::uint32_t i = 0; i < count && reader.good; ++i) {
+            std::string host = reader.str();
+            MirrorStats& s = ret[host];
+            // stored in thousandths, the binary format only knows integers
+            s.successes = reader.u64() / 1000.0;
+            s.failures = reader.u64() / 1000.0;
+            s.latency = reader.u64() / 1000.0;
+        }
+        if(!reader.good) ret.clear();
+        return ret;
+    }();
+    return stats;
+}
+
+std::string mirror_host(const std::string& url) {
+    size_t start = url.find("://");
+    start = start == std::string::npos ? 0 : start + 3;
+    return url.substr(0,url.find('/',start));
+}
+
+void record_mirror(const std::string& url, bool success, std::chrono::milliseconds time) {
+    std::lock_guard<std::mutex> lock(mirror_mutex);
+    MirrorStats& stats = mirror_stats()[mirror_host(url)];
+    stats.successes *= CATCARE_MIRROR_DECAY;
+    stats.failures *= CATCARE_MIRROR_DECAY;
+    if(!success) {
+        stats.failures += 1;
+        return;
+    }
+    stats.latency = stats.successes == 0 ? time.count() : stats.latency * 0.7 + time.count() * 0.3;
+    stats.successes += 1;
+}
+
+std::vector<std::string> rank_mirrors(std::vector<std::string> links) {
+    std::lock_guard<std::mutex> lock(mirror_mutex);
+    auto& stats = mirror_stats();
+    auto rank = [&](const std::string& link) {
+        auto found = stats.find(mirror_host(link));
+        if(found == stats.end()) return std::make_pair(false,0.0);
+        return std::make_pair(!found->second.healthy(),found->second.latency);
+    };
+    std::stable_sort(links.begin(),links.end(),[&](const std::string& a, const std::string& b) {
+        return rank(a) < rank(b);
+    });
+    return links;
+}
+
+void save_mirror_stats() {
+    if(arg_settings::no_config) return;
+    std::lock_guard<std::mutex> lock(mirror_mutex);
+    auto& stats = mirror_stats();
+    BinaryWriter writer;
+    writer.str(CATCARE_MIRROR_MAGIC).u32(stats.size());
+    for(const auto& [host,s] : stats) {
+        writer.str(host).u64(s.successes * 1000).u64(s.failures * 1000).u64(s.latency * 1000);
+    }
+    std::error_code ec;
+    std::filesystem::create_directories(mirror_stats_path().parent_path(),ec);
+    writer.to_file(mirror_stats_path());
+}
@@ -3,41 +3,244 @@
 #include "../inc/options.hpp"
 #include "../inc/pagelist.hpp"
 #include "../inc/catcaretaker-ccs-extension.hpp"
+#include "../inc/scriptcache.hpp"
+#include "../inc/transfer.hpp"
+#include "../inc/scriptrunner.hpp"
+#include "../inc/hashing.hpp"
+#include "../inc/mirrors.hpp"
+#include "../inc/archive.hpp"
 
 #include "../carescript/carescript-api.hpp"
 
+#include <set>
+
 using namespace carescript;
 
 #ifdef __linux__
 #include <curl/curl.h>
+#include <memory>
+#include <mutex>
 #include <unistd.h>
 #include <pwd.h>
+#include <fstream>
+
+// partial downloads older than this are started over, the remote file
+// may have changed in the meantime
+#define CATCARE_RESUME_MAX_AGE std::chrono::hours(24)
+
+static int option_number(std::string name, int fallback) {
+    try {
+        int value = std::stoi(option_or(name,std::to_string(fallback)));
+        if(value >= 0) return value;
+    }
+    catch(...) {}
+    return fallback;
+}
+
+// appends to the partial file, error pages are left out of it
+struct _PartialFile {
+    CURL* curl;
+    FILE* fp;
+    // bytes already in the file when the request was sent
+    curl_off_t offset;
+    std::string meta;
+    bool checked = false;
+    bool discard = false;
+    // what identifies this version of the remote file
+    std::string etag = "";
+    std::string last_modified = "";
+    curl_off_t range_start = -1;
+
+    std::string validator() const {
+        // weak etags can't be used for If-Range
+        if(etag != "" && etag.rfind("W/",0) != 0) return etag;
+        return last_modified;
+    }
+
+    static size_t header(char* data, size_t size, size_t count, void* self) {
+        _PartialFile& part = *(_PartialFile*)self;
+        std::string line(data,size * count);
+        while(!line.empty() && (line.back() == '\n' || line.back() == '\r')) line.pop_back();
+        // redirects and interim responses come with headers of their own
+        if(line.rfind("HTTP/",0) == 0) {
+            part.etag = part.last_modified = "";
+            part.range_start = -1;
+            return size * count;
+        }
+        size_t colon = line.find(':');
+        if(colon == std::string::npos) return size * count;
+        std::string name = line.substr(0,colon);
+        for(auto& c : name) c = std::tolower((unsigned char)c);
+        size_t start = line.find_first_not_of(' ',colon + 1);
+        std::string value = start == std::string::npos ? "" : line.substr(start);
+        if(name == "etag") part.etag = value;
+        else if(name == "last-modified") part.last_modified = value;
+        else if(name == "content-range" && value.rfind("bytes ",0) == 0) {
+            try { part.range_start = std::stoll(value.substr(6)); }
+            catch(...) {}
+        }
+        return size * count;
+    }
+
+    static size_t write(char* data, size_t size, size_t count, void* self) {
+        _PartialFile& part = *(_PartialFile*)self;
+        if(!part.checked) {
+            part.checked = true;
+            long http_code = 0;
+            curl_easy_getinfo(part.curl, CURLINFO_RESPONSE_CODE, &http_code);
+            part.discard = http_code >= 400;
+            if(part.discard) return size * count;
+            // a continuation starting elsewhere would corrupt the file
+            if(http_code == 206 && part.range_start != part.offset) return 0;
+            // the remote file changed, or the range was ignored: the whole
+            // file follows, the old content goes
+            if(http_code != 206 && part.offset > 0) {
+                fflush(part.fp);
+                if(ftruncate(fileno(part.fp),0) != 0) return 0;
+                part.offset = 0;
+            }
+            std::ofstream out(part.meta,std::ios::trunc);
+            out << part.validator();
+        }
+        if(part.discard) return size * count;
+        return fwrite(data,size,count,part.fp) * size;
+    }
+};
+
+// partial files of transfers running right now, two transfers of the same
+// url in one process must not write the same file
+static std::mutex partial_mutex;
+static std::set<std::string> partial_active;
+
+static bool transient(CURLcode res, long http_code) {
+    if(res == CURLE_OK) return http_code == 408 || http_code == 429 || http_code >= 500;
+    return res == CURLE_COULDNT_CONNECT || res == CURLE_OPERATION_TIMEDOUT || res == CURLE_PARTIAL_FILE
+        || res == CURLE_RECV_ERROR || res == CURLE_SEND_ERROR || res == CURLE_GOT_NOTHING
+        || res == CURLE_COULDNT_RESOLVE_HOST;
+}
 
-bool download_page(std::string url, std::string file) {
-    CURL *curl;
-    FILE *fp;
-    CURLcode res;
-    const char* aurl = url.c_str();
-    const char* outfilename = file.c_str();
-    curl = curl_easy_init();                                                                                                                                                                                                                                                           
-    if (curl) {   
-        fp = fopen(outfilename,"wb");
-        curl_easy_setopt(curl, CURLOPT_URL, aurl);
-        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, NULL);
-        curl_easy_setopt(curl, CURLOPT_WRITEDATA, fp);
-        res = curl_easy_perform(curl);
-        curl_easy_cleanup(curl);
+static std::string read_validator(std::string meta) {
+    std::ifstream in(meta);
+    std::string ret;
+    std::getline(in,ret);
+    return ret;
+}
+
+bool download_page(std::string url, std::string file, bool retry, std::chrono::milliseconds* first_byte) {
+    // one handle per thread, so consecutive transfers reuse the connection
+    thread_local std::unique_ptr<CURL,void(*)(CURL*)> handle(curl_easy_init(),curl_easy_cleanup);
+    CURL* curl = handle.get();
+    if(!curl) return false;
+
+    // the partial file lives outside catpkgs, so it survives clear_on_error.
+    // without a config directory it sits next to the file and only
+    // outlives failed attempts of this call
+    bool keep = !arg_settings::no_config;
+    std::error_code ec;
+    std::string base = file + ".part";
+    if(keep) {
+        std::filesystem::create_directories(CATCARE_RESUME_PATH,ec);
+        base = std::string(CATCARE_RESUME_PATH) + CATCARE_DIRSLASH + to_hex(fnv1a(url));
+    }
+    std::string part = base + ".part";
+    {
+        std::lock_guard<std::mutex> lock(partial_mutex);
+        for(int i = 1; !partial_active.insert(part).second; ++i) {
+            part = base + "-" + std::to_string(i) + ".part";
+        }
+    }
+    struct _Release {
+        std::string part;
+        ~_Release() {
+            std::lock_guard<std::mutex> lock(partial_mutex);
+            partial_active.erase(part);
+        }
+    } release{part};
+    // the validator of the remote file the partial file was started from
+    std::string meta = part + ".meta";
+    auto drop = [&]() {
+        std::filesystem::remove(part,ec);
+        std::filesystem::remove(meta,ec);
+    };
+
+    if(!keep || (std::filesystem::exists(part,ec) && std::filesystem::file_time_type::clock::now() - std::filesystem::last_write_time(part,ec) > CATCARE_RESUME_MAX_AGE)) {
+        drop();
+    }
+
+    int retries = retry ? option_number("download_retries",3) : 0;
+    int backoff = option_number("download_backoff",250);
+    // a stalled connection fails with CURLE_OPERATION_TIMEDOUT and is retried
+    int connect_timeout = option_number("download_connect_timeout",15);
+    int stall_timeout = option_number("download_stall_timeout",30);
+    for(int attempt = 0;; ++attempt) {
+        curl_off_t offset = std::filesystem::exists(part,ec) ? (curl_off_t)std::filesystem::file_size(part,ec) : 0;
+        // nothing to tell whether the remote file is still the same one
+        std::string validator = offset > 0 ? read_validator(meta) : "";
+        if(offset > 0 && validator == "") {
+            drop();
+            offset = 0;
+        }
+        FILE* fp = fopen(part.c_str(),"ab");
+        if(!fp) return false;
+        _PartialFile partial{curl,fp,offset,meta};
+
+        curl_easy_reset(curl);
+        curl_easy_setopt(curl, CURLOPT_URL, url.c_str());
+        curl_easy_setopt(curl, CURLOPT_WRITEFUNCTION, _PartialFile::write);
+        curl_easy_setopt(curl, CURLOPT_WRITEDATA, &partial);
+        curl_easy_setopt(curl, CURLOPT_HEADERFUNCTION, _PartialFile::header);
+        curl_easy_setopt(curl, CURLOPT_HEADERDATA, &partial);
+        curl_easy_setopt(curl, CURLOPT_CONNECTTIMEOUT, (long)connect_timeout);
+        if(stall_timeout != 0) {
+            curl_easy_setopt(curl, CURLOPT_LOW_SPEED_LIMIT, 1L);
+            curl_easy_setopt(curl, CURLOPT_LOW_SPEED_TIME, (long)stall_timeout);
+        }
+        // If-Range makes the server send the whole file if it changed
+        std::unique_ptr<curl_slist,void(*)(curl_slist*)> headers(nullptr,curl_slist_free_all);
+        std::string range = std::to_string(offset) + "-";
+        if(offset > 0) {
+            headers.reset(curl_slist_append(nullptr,("If-Range: " + validator).c_str()));
+            curl_easy_setopt(curl, CURLOPT_HTTPHEADER, headers.get());
+            curl_easy_setopt(curl, CURLOPT_RANGE, range.c_str());
+        }
+        CURLcode res = curl_easy_perform(curl);
         long http_code = 0;
         curl_easy_getinfo(curl, CURLINFO_RESPONSE_CODE, &http_code);
         fclose(fp);
 
-        if(res != 0 || (http_code >= 400 && http_code <= 599)) {
-            std::filesystem::remove_all(file);
+        if(res == CURLE_OK && http_code < 400) {
+            double start = 0;
+            if(first_byte && curl_easy_getinfo(curl, CURLINFO_STARTTRANSFER_TIME, &start) == CURLE_OK)
+                *first_byte = std::chrono::milliseconds((long long)(start * 1000));
+            std::filesystem::remove(meta,ec);
+            ec.clear();
+            std::filesystem::rename(part,file,ec);
+            if(ec) {
+                // the resume directory may be on another file system
+                ec.clear();
+                std::filesystem::copy_file(part,file,std::filesystem::copy_options::overwrite_existing,ec);
+                std::error_code remove_ec;
+                std::filesystem::remove(part,remove_ec);
+            }
+            return !ec;
+        }
+
+        // the partial file doesn't fit the remote one anymore, or the
+        // server can't continue it
+        if(http_code == 416 || res == CURLE_RANGE_ERROR || (res == CURLE_WRITE_ERROR && http_code == 206)) {
+            drop();
+        }
+        else if(!transient(res,http_code)) {
+            drop();
             return false;
         }
-        return true;
-    }   
-    return false;
+        if(attempt >= retries) {
+            // only content is worth keeping for the next run
+            if(!keep || std::filesystem::file_size(part,ec) == 0) drop();
+            return false;
+        }
+        std::this_thread::sleep_for(std::chrono::milliseconds(backoff << std::min(attempt,10)));
+    }
 }
 
 std::string get_username() {
@@ -54,7 +257,7 @@ std::string get_username() {
 #include <Lcmd.h>
 #include <codecvt>
 
-bool download_page(std::string url, std::string file) {
+bool download_page(std::string url, std::string file, bool retry, std::chrono::milliseconds* first_byte) {
     const wchar_t* srcURL = std::wstring(url.begin(),url.end()).c_str();
     const wchar_t* destFile = std::wstring(file.begin(),file.end()).c_str();
 
@@ -83,23 +286,50 @@ std::string get_username() {
 
 #else
 std::string get_username() {}
-bool download_page(std::string url, std::string file) {}
+bool download_page(std::string url, std::string file, bool retry, std::chrono::milliseconds* first_byte) {}
 #endif
 
+// the compiled rules are cached, keyed by the hash of urlrules.ccr
 void fill_global_pagelist() {
-    std::ifstream iff(CATCARE_URLRULES_FILE);
-    std::string source = "";
-    while(iff.good()) source += iff.get();
-    if(source != "") source.pop_back();
-
-    global_rulelist = process_rulelist(source);
+    std::ifstream iff(CATCARE_URLRULES_FILE,std::ios::binary);
+    std::string source(std::istreambuf_iterator<char>(iff),{});
+
+    std::uint64_t key = fnv1a(source,fnv1a(CATCARE_RULES_CACHE_VERSION));
+    std::filesystem::path cache = std::filesystem::path(CATCARE_CACHE_PATH) / "urlrules.cache";
+    if(arg_settings::no_config || !load_rules(cache,key,global_rulelist)) {
+        global_rulelist = compile_rules(process_rulelist(source));
+        if(!arg_settings::no_config) save_rules(cache,key,global_rulelist);
+    }
+    global_rulelist.source_hash = key;
 }
 
 std::vector<UrlPackage> get_download_url(std::string input) {
+    return resolve_batch({input})[0].candidates;
+}
+
+std::vector<Resolution> resolve_batch(const std::vector<std::string>& specs) {
+    static std::mutex mutex;
+    static std::uint64_t memo_hash = 0;
+    static std::unordered_map<std::string,std::vector<UrlPackage>> memo;
+
+    std::lock_guard<std::mutex> lock(mutex);
     if(global_rulelist.empty())
         fill_global_pagelist();
+    if(memo_hash != global_rulelist.source_hash) {
+        memo.clear();
+        memo_hash = global_rulelist.source_hash;
+    }
 
-    return find_url(global_rulelist,to_lowercase(input));
+    std::vector<Resolution> ret;
+    ret.reserve(specs.size());
+    for(const auto& i : specs) {
+        std::string spec = to_lowercase(i);
+        auto found = memo.find(spec);
+        if(found == memo.end())
+            found = memo.emplace(spec,find_url(global_rulelist,spec)).first;
+        ret.push_back({i,found->second});
+    }
+    return ret;
 }
 std::string app2url(std::string url, std::string app) {
     if(url != "" && url.back() != '/') url += "/";
@@ -121,24 +351,34 @@ void download_dependencies(IniList list) {
 #define CLEAR_ON_ERR() if(option_or("clear_on_error","true") == "true") {std::filesystem::remove_all(CATCARE_ROOT + CATCARE_DIRSLASH + name);}
 #define IFERR(interp) if(!interp) { CLEAR_ON_ERR(); return interp.error(); }
 
-bool download_scripts(IniList scripts,std::string install_url, std::string name) {
-    Interpreter interpreter;
-    bake_extension(get_extension(),interpreter.settings);
-    load_extensions(interpreter);
+bool download_scripts(IniList scripts, IniList independent, std::vector<std::string> links, std::string name) {
+    Interpreter interpreter(script_prototype());
+    bool review = option_or("show_script_src","false") == "true";
+    // reviewed scripts are shown one after another, so nothing runs in parallel
+    if(review) {
+        scripts.insert(scripts.end(),independent.begin(),independent.end());
+        independent.clear();
+    }
+
+    // every script is fetched up front, concurrently
+    std::map<std::string,std::shared_future<bool>> transfers;
+    for(auto list : {&scripts,&independent}) {
+        for(auto i : *list) {
+            if(i.get_type() != IniType::String || transfers.count((std::string)i) != 0) continue;
+            print_message("DOWNLOAD","Downloading script: " + (std::string)i);
+            transfers[(std::string)i] = transfer_engine().enqueue(links,(std::string)i,CATCARE_ROOT + CATCARE_DIRSLASH + name + CATCARE_DIRSLASH + (std::string)i);
+        }
+    }
 
     for(auto i : scripts) {
         if(i.get_type() == IniType::String) {
-            print_message("DOWNLOAD","Downloading script: " + (std::string)i);
-            if(!download_page(install_url + (std::string)i,CATCARE_ROOT + CATCARE_DIRSLASH + name + CATCARE_DIRSLASH + (std::string)i)) {
-                print_message("ERROR","Failed to download script!");
+            if(!transfers[(std::string)i].get()) {
+                print_message("ERROR","Failed to download script: " + (std::string)i);
                 continue;
             }
-            std::string source;
-            std::ifstream ifile(CATCARE_ROOT + CATCARE_DIRSLASH + name + CATCARE_DIRSLASH + (std::string)i);
-            while(ifile.good()) source += ifile.get();
-            if(source != "") source.pop_back();
+            std::string source = read_script(CATCARE_ROOT + CATCARE_DIRSLASH + name + CATCARE_DIRSLASH + (std::string)i);
 
-            if(option_or("show_script_src","false") == "true") {
+            if(review) {
                 KittenLexer line_lexer = KittenLexer()
                     .add_linebreak('\n');
                 auto lexed = line_lexer.lex(source);
@@ -166,18 +406,33 @@ bool download_scripts(IniList scripts,std::string install_url, std::string name)
             }
 
             print_message("INFO","Entering CCScript: \"" + (std::string)i + "\"");
-            interpreter.pre_process(source).on_error([&](Interpreter& i) {
-                print_message("ERROR","Script failed:\n" + i.error());
-            });
-            interpreter.run().on_error([&](Interpreter& i) {
+            load_script(interpreter,source).on_error([&](Interpreter& i) {
                 print_message("ERROR","Script failed:\n" + i.error());
             });
+            std::string error = run_limited(interpreter);
+            if(error != "") print_message("ERROR","Script failed:\n" + error);
+        }
+    }
+
+    std::vector<IsolatedScript> isolated;
+    for(auto i : independent) {
+        if(i.get_type() != IniType::String) continue;
+        if(!transfers[(std::string)i].get()) {
+            print_message("ERROR","Failed to download script: " + (std::string)i);
+            continue;
         }
+        isolated.push_back({(std::string)i,read_script(CATCARE_ROOT + CATCARE_DIRSLASH + name + CATCARE_DIRSLASH + (std::string)i),"main",{}});
+    }
+    if(!isolated.empty()) {
+        print_message("INFO","Running " + std::to_string(isolated.size()) + " independent CCScripts...");
+        print_isolated(isolated,run_isolated(isolated),"CCScript");
     }
     return false;
 }
 
-std::string download_project(std::string install_url) {
+static std::string install_project(std::string install_url, std::vector<std::string> mirrors);
+
+std::string download_project(std::string install_url, std::vector<std::string> mirrors) {
     make_register();
     if(!arg_settings::global) make_checklist();
     
@@ -187,34 +442,63 @@ std::string download_project(std::string install_url) {
     if(install_url == "") {
         return "Could not resolve url key " + install_url;
     }
+    // installs further down on this thread, the dependencies
+    thread_local int depth = 0;
+    // already being installed alongside. only the projects asked for wait
+    // for it, a dependency waiting could close a cycle
+    std::string error;
+    if(!claim_install(install_url,error,depth == 0)) return error;
+
+    struct _Finish {
+        std::string url;
+        std::string error = "The install was aborted";
+        int& depth;
+        ~_Finish() {
+            --depth;
+            finish_install(url,error);
+        }
+    } finish{install_url,"The install was aborted",++depth};
+    return finish.error = install_project(install_url,mirrors);
+}
 
-    std::filesystem::create_directory(CATCARE_ROOT + CATCARE_DIRSLASH + "__tmp");
-    if(!download_page(install_url + CATCARE_CHECKLISTNAME,CATCARE_ROOT + CATCARE_DIRSLASH + "__tmp" + CATCARE_DIRSLASH CATCARE_CHECKLISTNAME)) {
-        std::filesystem::remove_all(CATCARE_ROOT + CATCARE_DIRSLASH + "__tmp");
+static std::string install_project(std::string install_url, std::vector<std::string> mirrors) {
+    // the fastest healthy mirror is asked first, every file fails over on its own
+    std::vector<std::string> links = rank_mirrors(mirrors.empty() ? std::vector<std::string>{install_url} : mirrors);
+    struct _SaveStats { ~_SaveStats() { save_mirror_stats(); } } save_stats;
+    // unique, several projects may install at the same time
+    std::string tmp = "__tmp_" + to_hex(fnv1a(install_url));
+
+    std::filesystem::create_directory(CATCARE_ROOT + CATCARE_DIRSLASH + tmp);
+    if(!transfer_engine().enqueue(links,CATCARE_CHECKLISTNAME,CATCARE_ROOT + CATCARE_DIRSLASH + tmp + CATCARE_DIRSLASH CATCARE_CHECKLISTNAME).get()) {
+        std::filesystem::remove_all(CATCARE_ROOT + CATCARE_DIRSLASH + tmp);
         return "Could not download checklist!";
     }
-    IniFile checklist = IniFile::from_file(CATCARE_ROOT + CATCARE_DIRSLASH + "__tmp" + CATCARE_DIRSLASH CATCARE_CHECKLISTNAME);
+    IniFile checklist = IniFile::from_file(CATCARE_ROOT + CATCARE_DIRSLASH + tmp + CATCARE_DIRSLASH CATCARE_CHECKLISTNAME);
     if(!checklist) {
-        // std::filesystem::remove_all(CATCARE_ROOT + CATCARE_DIRSLASH + "__tmp");
+        // std::filesystem::remove_all(CATCARE_ROOT + CATCARE_DIRSLASH + tmp);
         return "Error in checklist: " + checklist.error_msg();
     }
 
     IniDictionary configs = extract_configs(checklist);
     if(!valid_configs(configs)) {
-        std::filesystem::remove_all(CATCARE_ROOT + CATCARE_DIRSLASH + "__tmp");
+        std::filesystem::remove_all(CATCARE_ROOT + CATCARE_DIRSLASH + tmp);
         return config_healthcare(configs);
     }
     std::string name = to_lowercase((std::string)configs["name"]);
 
-    if(std::filesystem::exists(CATCARE_ROOT + CATCARE_DIRSLASH + name)) {
-        std::filesystem::remove_all(CATCARE_ROOT + CATCARE_DIRSLASH + name);
-    }
+    replace_project(name);
     std::filesystem::create_directories(CATCARE_ROOT + CATCARE_DIRSLASH + name);
     std::filesystem::create_symlink(".." CATCARE_DIRSLASH ".." CATCARE_DIRSLASH + CATCARE_ROOT_NAME, CATCARE_ROOT + CATCARE_DIRSLASH + name + CATCARE_DIRSLASH + CATCARE_ROOT_NAME);
-    std::filesystem::copy(CATCARE_ROOT + CATCARE_DIRSLASH + "__tmp" + CATCARE_DIRSLASH CATCARE_CHECKLISTNAME, CATCARE_ROOT + CATCARE_DIRSLASH + name + CATCARE_DIRSLASH CATCARE_CHECKLISTNAME);
-    std::filesystem::remove_all(CATCARE_ROOT + CATCARE_DIRSLASH + "__tmp");
+    std::filesystem::copy(CATCARE_ROOT + CATCARE_DIRSLASH + tmp + CATCARE_DIRSLASH CATCARE_CHECKLISTNAME, CATCARE_ROOT + CATCARE_DIRSLASH + name + CATCARE_DIRSLASH CATCARE_CHECKLISTNAME);
+    std::filesystem::remove_all(CATCARE_ROOT + CATCARE_DIRSLASH + tmp);
    
     IniList files = configs["files"].to_list();
+    // files download concurrently on the transfer engine, directories are
+    // created right away so files listed after them can be written
+    std::vector<std::pair<std::string,std::shared_future<bool>>> transfers;
+    // projects shipping an archive get all their files in one request
+    std::string archive = configs.count("archive") != 0 ? (std::string)configs["archive"] : "";
+    std::map<std::string,std::string> archived;
 
     for(auto i : files) {
         if(i.get_type() != IniType::String) {
@@ -243,25 +527,49 @@ std::string download_project(std::string install_url) {
                 continue;
             }
             std::string ufile = last_name(file);
-            print_message("DOWNLOAD","Downloading file: " + ufile);
-            if(!download_page(install_url + file,CATCARE_ROOT + CATCARE_DIRSLASH + name + CATCARE_DIRSLASH + ufile)) {
-                CLEAR_ON_ERR()
-                return "Error downloading file: " + ufile;
+            if(archive != "") {
+                archived[file] = CATCARE_ROOT + CATCARE_DIRSLASH + name + CATCARE_DIRSLASH + ufile;
+                continue;
             }
+            print_message("DOWNLOAD","Downloading file: " + ufile);
+            transfers.push_back({ufile,transfer_engine().enqueue(links,file,CATCARE_ROOT + CATCARE_DIRSLASH + name + CATCARE_DIRSLASH + ufile)});
         }
         else {
+            if(archive != "") {
+                archived[file] = CATCARE_ROOT + CATCARE_DIRSLASH + name + CATCARE_DIRSLASH + file;
+                continue;
+            }
             print_message("DOWNLOAD","Downloading file: " + file);
-            if(!download_page(install_url + file,CATCARE_ROOT + CATCARE_DIRSLASH + name + CATCARE_DIRSLASH + file)) {
-                CLEAR_ON_ERR()
-                return "Error downloading file: " + file;
+            transfers.push_back({file,transfer_engine().enqueue(links,file,CATCARE_ROOT + CATCARE_DIRSLASH + name + CATCARE_DIRSLASH + file)});
+        }
+    }
+
+    if(!archived.empty()) {
+        std::string url = archive.find("://") != std::string::npos ? archive : links.front() + archive;
+        print_message("DOWNLOAD","Extracting " + std::to_string(archived.size()) + " files from: " + url);
+        std::string error = download_archive(url,archived);
+        if(error != "") {
+            print_message("INFO","Downloading the files one by one instead\n-> " + error);
+            for(const auto& [file,path] : archived) {
+                transfers.push_back({file,transfer_engine().enqueue(links,file,path)});
             }
         }
     }
 
-    if(configs.count("scripts") != 0 && option_or("no_scripts","false") == "false") {
+    std::string failed;
+    for(auto& i : transfers) {
+        if(!i.second.get() && failed == "") failed = i.first;
+    }
+    if(failed != "") {
+        CLEAR_ON_ERR()
+        return "Error downloading file: " + failed;
+    }
+
+    if((configs.count("scripts") != 0 || configs.count("independent_scripts") != 0) && option_or("no_scripts","false") == "false") {
         IniList scripts = configs["scripts"].to_list();
+        IniList independent = configs["independent_scripts"].to_list();
 
-        if(download_scripts(scripts,install_url,name)) {
+        if(download_scripts(scripts,independent,links,name)) {
             return "";
         }
     }
@@ -269,12 +577,97 @@ std::string download_project(std::string install_url) {
     if(!installed(install_url)) {
         add_to_register(install_url, name);
     }
+    lock_project(install_url,name,configs.count("version") != 0 ? (std::string)configs["version"] : "");
 
     download_dependencies(configs["dependencies"].to_list());
 
     return "";
 }
 
+// installed path -> path in the project, directories are left out
+static std::map<std::string,std::string> listed_files(IniList files) {
+    std::map<std::string,std::string> ret;
+    for(auto i : files) {
+        if(i.get_type() != IniType::String) continue;
+        std::string file = (std::string)i;
+        if(file.empty() || file[0] == '$' || file[0] == '#') continue;
+        if(file[0] == '!') {
+            file.erase(file.begin());
+            if(file.empty()) continue;
+            ret[last_name(file)] = file;
+        }
+        else ret[file] = file;
+    }
+    return ret;
+}
+
+bool delta_update(std::string install_url, std::string name, std::vector<std::string> mirrors) {
+    std::string root = CATCARE_ROOT + CATCARE_DIRSLASH + name;
+    if(!std::filesystem::exists(root + CATCARE_DIRSLASH CATCARE_CHECKLISTNAME)) return false;
+
+    std::string tmp = CATCARE_ROOT + CATCARE_DIRSLASH + "__tmp_" + to_hex(fnv1a(install_url));
+    struct _RemoveTmp { std::string path; ~_RemoveTmp() { std::error_code ec; std::filesystem::remove_all(path,ec); } } remove_tmp{tmp};
+    std::filesystem::create_directory(tmp);
+    std::vector<std::string> links = rank_mirrors(mirrors.empty() ? std::vector<std::string>{install_url} : mirrors);
+    struct _SaveStats { ~_SaveStats() { save_mirror_stats(); } } save_stats;
+    if(!transfer_engine().enqueue(links,CATCARE_CHECKLISTNAME,tmp + CATCARE_DIRSLASH CATCARE_CHECKLISTNAME).get()) {
+        return false;
+    }
+    IniDictionary configs = extract_configs(IniFile::from_file(tmp + CATCARE_DIRSLASH CATCARE_CHECKLISTNAME));
+    if(!valid_configs(configs) || configs.count("hashes") == 0 || to_lowercase((std::string)configs["name"]) != name) {
+        return false;
+    }
+    std::map<std::string,std::string> hashes = parse_file_hashes(configs["hashes"].to_list());
+
+    // without a hash for every file there's no telling what changed
+    std::map<std::string,std::string> files = listed_files(configs["files"].to_list());
+    for(const auto& i : files) {
+        if(hashes.count(i.second) == 0) return false;
+    }
+
+    for(auto i : configs["files"].to_list()) {
+        if(i.get_type() == IniType::String && ((std::string)i).size() > 1 && ((std::string)i)[0] == '$') {
+            std::filesystem::create_directories(root + CATCARE_DIRSLASH + ((std::string)i).substr(1));
+        }
+    }
+
+    std::vector<std::pair<std::string,std::shared_future<bool>>> transfers;
+    for(const auto& [local,file] : files) {
+        std::string path = root + CATCARE_DIRSLASH + local;
+        if(std::filesystem::is_regular_file(path) && hash_file(path) == hashes[file]) continue;
+        print_message("DOWNLOAD","Updating file: " + local);
+        transfers.push_back({local,transfer_engine().enqueue(links,file,path)});
+    }
+    for(auto& i : transfers) {
+        if(!i.second.get() || hash_file(root + CATCARE_DIRSLASH + i.first) != hashes[files[i.first]]) {
+            print_message("ERROR","Could not update file: " + i.first);
+            return false;
+        }
+    }
+
+    // files the new version doesn't list anymore
+    IniDictionary old = extract_configs(IniFile::from_file(root + CATCARE_DIRSLASH CATCARE_CHECKLISTNAME));
+    if(old.count("files") != 0 && old["files"].get_type() == IniType::List) {
+        for(const auto& i : listed_files(old["files"].to_list())) {
+            if(files.count(i.first) != 0) continue;
+            print_message("DELETE","Removing file: " + i.first);
+            std::error_code ec;
+            std::filesystem::remove(root + CATCARE_DIRSLASH + i.first,ec);
+        }
+    }
+    std::filesystem::copy_file(tmp + CATCARE_DIRSLASH CATCARE_CHECKLISTNAME,root + CATCARE_DIRSLASH CATCARE_CHECKLISTNAME,std::filesystem::copy_options::overwrite_existing);
+    print_message("INFO","Updated " + std::to_string(transfers.size()) + " of " + std::to_string(files.size()) + " files of " + name);
+
+    if((configs.count("scripts") != 0 || configs.count("independent_scripts") != 0) && option_or("no_scripts","false") == "false") {
+        if(download_scripts(configs["scripts"].to_list(),configs["independent_scripts"].to_list(),links,name)) {
+            return true;
+        }
+    }
+    lock_project(install_url,name,configs.count("version") != 0 ? (std::string)configs["version"] : "");
+    download_dependencies(configs["dependencies"].to_list());
+    return true;
+}
+
 IniFile download_checklist(std::string url) {
     bool existed = std::filesystem::exists(CATCARE_TMP_PATH);
     if(!existed) std::filesystem::create_directory(CATCARE_TMP_PATH);
@@ -290,38 +683,150 @@ IniFile download_checklist(std::string url) {
     return file;
 }
 
-#define REMOVE_TMP() std::filesystem::remove_all(CATCARE_TMP_PATH)
-#define RETURN_TUP(a,b) return std::make_tuple<std::string,std::string>(a,b)
+// the version a checklist declares, "" if it has none
+static std::string checklist_version(IniFile file) {
+    if(!file || !file.has("version","Info")) return "";
+    auto version = file.get("version","Info");
+    if(version.get_type() != IniType::String) return "";
+    return (std::string)version;
+}
+
+// new - old of the installed project name, given the newest version
+static std::tuple<std::string,std::string> version_change(std::string newest, std::string name) {
+    if(newest == "") return {"",""};
+    std::string current = checklist_version(IniFile::from_file(CATCARE_ROOT + CATCARE_DIRSLASH + name + CATCARE_DIRSLASH CATCARE_CHECKLISTNAME));
+    if(current == "") return {newest,"???"};
+    if(newest != current) return {newest,current};
+    return {"",""};
+}
 
 std::tuple<std::string,std::string> needs_update(std::string project_url) {
-    if(!installed(project_url)) RETURN_TUP("","");
-    std::string name = url2name(project_url);
+    if(!installed(project_url)) return {"",""};
 
     std::filesystem::create_directories(CATCARE_TMP_PATH);
     download_page(project_url + CATCARE_CHECKLISTNAME,CATCARE_TMP_PATH CATCARE_DIRSLASH CATCARE_CHECKLISTNAME);
-    IniFile r = IniFile::from_file(CATCARE_TMP_PATH CATCARE_DIRSLASH CATCARE_CHECKLISTNAME);
-    if(!r || !r.has("version","Info")) {
-        REMOVE_TMP(); RETURN_TUP("","");
-    }
+    std::string newest = checklist_version(IniFile::from_file(CATCARE_TMP_PATH CATCARE_DIRSLASH CATCARE_CHECKLISTNAME));
+    std::filesystem::remove_all(CATCARE_TMP_PATH);
+    return version_change(newest,url2name(project_url));
+}
 
-    auto newest_version = r.get("version","Info");
-    if(newest_version.get_type() != IniType::String) { REMOVE_TMP(); RETURN_TUP("",""); }
+SyncPlan plan_sync() {
+    SyncPlan plan;
+    make_register();
+    std::map<std::string,LockEntry> lock = read_lockfile();
 
-    r = IniFile::from_file(CATCARE_ROOT + CATCARE_DIRSLASH + name + CATCARE_DIRSLASH CATCARE_CHECKLISTNAME);
-    if(!r || !r.has("version","Info")) { REMOVE_TMP(); RETURN_TUP((std::string)newest_version,"???"); }
+    // the dependency list and everything the installed projects depend on
+    std::vector<std::string> queue;
+    for(auto i : get_dependencylist()) {
+        if(i.get_type() == IniType::String) queue.push_back((std::string)i);
+    }
+    std::set<std::string> wanted;
+    // mirrors come from the rule the link was made by, if any
+    auto step = [](std::string name, std::string url, std::string reason) {
+        std::vector<UrlPackage> found = get_download_url(url);
+        return SyncPlan::Step{name,url,reason,found.size() == 1 ? found[0].mirrors : std::vector<std::string>{}};
+    };
+    // installed projects whose remote version decides, with whether
+    // they are locked already
+    std::vector<std::pair<SyncPlan::Step,bool>> remote;
+    for(size_t i = 0; i < queue.size(); ++i) {
+        std::string url = queue[i];
+        if(!wanted.insert(url).second) continue;
+
+        std::string name = url2name(url);
+        if(name == "") {
+            plan.add.push_back(step("",url,"not installed"));
+            continue;
+        }
+        if(lock.count(name) != 0 && lock[name].url != url) {
+            plan.update.push_back(step(name,url,"locked to " + lock[name].url));
+        }
+        else if(lock.count(name) != 0 && !matches_lock(lock[name],name)) {
+            plan.update.push_back(step(name,url,"changed locally"));
+        }
+        else remote.push_back({step(name,url,""),lock.count(name) != 0});
 
-    auto current_version = r.get("version","Info");
-    if(current_version.get_type() != IniType::String) {
-        REMOVE_TMP(); RETURN_TUP((std::string)newest_version,"???");
+        IniFile checklist = IniFile::from_file(CATCARE_ROOT + CATCARE_DIRSLASH + name + CATCARE_DIRSLASH CATCARE_CHECKLISTNAME);
+        if(!checklist) continue;
+        for(auto j : checklist.get("dependencies","Download").to_list()) {
+            if(j.get_type() == IniType::String) queue.push_back((std::string)j);
+        }
     }
-    
-    if(newest_version.to_string() != current_version.to_string()) {
-        REMOVE_TMP(); RETURN_TUP((std::string)newest_version,(std::string)current_version);
+
+    // the remote checklists are fetched all at once, from the mirrors if
+    // the project has any
+    std::string tmp = CATCARE_ROOT + CATCARE_DIRSLASH + "__tmp_sync";
+    struct _RemoveTmp { std::string path; ~_RemoveTmp() { std::error_code ec; std::filesystem::remove_all(path,ec); } } remove_tmp{tmp};
+    if(!remote.empty()) std::filesystem::create_directories(tmp);
+    std::vector<std::shared_future<bool>> transfers;
+    for(auto& [i,locked] : remote) {
+        std::vector<std::string> links = rank_mirrors(i.mirrors.empty() ? std::vector<std::string>{i.url} : i.mirrors);
+        transfers.push_back(transfer_engine().enqueue(links,CATCARE_CHECKLISTNAME,tmp + CATCARE_DIRSLASH + i.name));
+    }
+    for(size_t i = 0; i < remote.size(); ++i) {
+        auto& [s,locked] = remote[i];
+        std::string newest = transfers[i].get() ? checklist_version(IniFile::from_file(tmp + CATCARE_DIRSLASH + s.name)) : "";
+        auto [newv,oldv] = version_change(newest,s.name);
+        if(newv != "") {
+            s.reason = oldv + " -> " + newv;
+            plan.update.push_back(s);
+        }
+        else if(locked) {
+            s.reason = "up to date";
+            plan.keep.push_back(s);
+        }
+        // installed before there was a lock, but what the remote serves
+        else if(newest != "") {
+            s.reason = "locks " + newest;
+            plan.lock.push_back(s);
+        }
+        else {
+            s.reason = "not locked";
+            plan.update.push_back(s);
+        }
     }
+    if(!remote.empty()) save_mirror_stats();
 
-    REMOVE_TMP();
-    RETURN_TUP("","");
+    for(auto i : get_register()) {
+        if(i.second.get_type() != IniType::String) continue;
+        if(wanted.count((std::string)i.second) == 0) {
+            plan.remove.push_back(step(i.first,(std::string)i.second,"no longer needed"));
+        }
+    }
+    return plan;
 }
 
-#undef REMOVE_TMP
-#undef RETURN_TUP
\ No newline at end of file
+bool apply_sync(const SyncPlan& plan) {
+    for(auto& i : plan.lock) {
+        print_message("INFO","Locking project: " + i.name);
+        lock_project(i.url,i.name,checklist_version(IniFile::from_file(CATCARE_ROOT + CATCARE_DIRSLASH + i.name + CATCARE_DIRSLASH CATCARE_CHECKLISTNAME)));
+    }
+    for(auto& i : plan.remove) {
+        print_message("DELETE","Removing project: " + i.name);
+        std::filesystem::remove_all(CATCARE_ROOT + CATCARE_DIRSLASH + i.name);
+        remove_from_register(i.name);
+    }
+    // only the changed files are fetched where the remote lists hashes
+    std::vector<SyncPlan::Step> reinstall;
+    for(auto& i : plan.update) {
+        if(delta_update(i.url,i.name,i.mirrors)) continue;
+        std::filesystem::remove_all(CATCARE_ROOT + CATCARE_DIRSLASH + i.name);
+        remove_from_register(i.name);
+        reinstall.push_back(i);
+    }
+
+    reinstall.insert(reinstall.end(),plan.add.begin(),plan.add.end());
+
+    bool success = true;
+    for(auto& i : reinstall) {
+        // may already have come in as a dependency of another one
+        if(installed(i.url)) continue;
+        print_message("DOWNLOAD","Downloading dependency: \"" + i.url + "\"");
+        std::string error = download_project(i.url,i.mirrors);
+        if(error != "") {
+            print_message("ERROR","Error while downloading dependency: \"" + i.url + "\"\n-> " + error);
+            success = false;
+        }
+    }
+    return success;
+}
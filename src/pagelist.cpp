@@ -1,4 +1,5 @@
 #include "../inc/pagelist.hpp"
+#include "../inc/serialize.hpp"
 #include <regex>
 
 RuleList process_rulelist(std::string source) {
@@ -70,8 +71,84 @@ Url parse_link(std::string source) {
     return ret;
 }
 
-std::vector<UrlPackage> find_url(RuleList list, std::string source) {
-    if(is_url(source)) return {{{"$empty$"},source}};
+static std::string shape_key(size_t parts, const std::string& separators) {
+    return std::to_string(parts) + separators;
+}
+
+RuleMatcher compile_rules(const RuleList& rules) {
+    RuleMatcher matcher;
+    for(const auto& [name,rule] : rules) {
+        size_t index = matcher.rules.size();
+        matcher.rules.push_back(rule);
+        std::string symbols(rule.symbols.begin(),rule.symbols.end());
+
+        // an input with n parts fills the placeholders at the positions
+        // below n, the remaining ones need a default
+        for(size_t n = 0; n <= symbols.size() + 1; ++n) {
+            bool filled = true;
+            for(const auto& i : rule.link.placeholders) {
+                auto pos = rule.positions.find(i);
+                if((pos == rule.positions.end() || pos->second >= (int)n) && rule.defaults.count(i) == 0) {
+                    filled = false;
+                    break;
+                }
+            }
+            if(!filled) continue;
+            if(n != 0) matcher.shapes[shape_key(n,symbols.substr(0,n - 1))].push_back(index);
+            // with a trailing separator, like "user/project/"
+            if(n <= symbols.size()) matcher.shapes[shape_key(n,symbols.substr(0,n))].push_back(index);
+        }
+    }
+    return matcher;
+}
+
+static std::string fill_link(const Url& link, std::map<std::string,std::string>& mp) {
+    std::string s;
+    for(const auto& u : link.url) {
+        if(u.front() == '{') s += mp[u.substr(1,u.size() - 2)];
+        else s += u;
+    }
+    return s;
+}
+
+// the reverse of fill_link, false if url doesn't have the shape of link
+static bool match_link(const Url& link, const std::string& url, std::map<std::string,std::string>& mp) {
+    size_t pos = 0;
+    for(size_t i = 0; i < link.url.size(); ++i) {
+        const std::string& part = link.url[i];
+        if(part.front() != '{') {
+            if(url.compare(pos,part.size(),part) != 0) return false;
+            pos += part.size();
+            continue;
+        }
+        // a placeholder reaches up to the next fixed part
+        size_t end = url.size();
+        if(i + 1 < link.url.size() && link.url[i + 1].front() != '{') {
+            end = url.find(link.url[i + 1],pos);
+            if(end == std::string::npos) return false;
+        }
+        if(end == pos) return false;
+        mp[part.substr(1,part.size() - 2)] = url.substr(pos,end - pos);
+        pos = end;
+    }
+    return pos == url.size();
+}
+
+std::vector<UrlPackage> find_url(const RuleMatcher& matcher, const std::string& source) {
+    if(is_url(source)) {
+        UrlPackage package;
+        package.rule.name = "$empty$";
+        package.link = source;
+        // plain links of a rule with mirrors can use those as well
+        for(const auto& rule : matcher.rules) {
+            std::map<std::string,std::string> mp;
+            if(rule.mirrors.empty() || !match_link(rule.link,source,mp)) continue;
+            package.mirrors = {source};
+            for(const auto& i : rule.mirrors) package.mirrors.push_back(fill_link(i,mp));
+            break;
+        }
+        return {package};
+    }
     std::vector<UrlPackage> ret;
     KittenLexer lexer = KittenLexer()
         .add_con_extract(is_message_split_sign)
@@ -79,40 +156,138 @@ std::vector<UrlPackage> find_url(RuleList list, std::string source) {
         .ignore_backslash_opts();
     const auto args = lexer.lex(source);
 
-    for(auto i : list) {
-        Rule rule = i.second;
-        std::string s;
-        std::map<std::string,std::string> mp;
+    // every other token is a separator, only its first character counts
+    std::string separators;
+    for(size_t j = 1; j < args.size(); j += 2) separators += args[j].src[0];
+    auto found = matcher.shapes.find(shape_key((args.size() + 1) / 2,separators));
+    if(found == matcher.shapes.end()) return ret;
+
+    for(size_t index : found->second) {
+        const Rule& rule = matcher.rules[index];
+        std::map<std::string,std::string> mp = rule.defaults;
+        for(size_t j = 0; j < args.size(); j += 2) {
+            auto name = rule.rvpositions.find(j / 2);
+            if(name != rule.rvpositions.end()) mp[name->second] = args[j].src;
+        }
 
-        for(auto j : rule.link.placeholders) mp[j] = "";
-        for(auto j : rule.defaults) mp[j.first] = j.second;
+        std::string s = fill_link(rule.link,mp);
+        std::vector<std::string> mirrors = {s};
+        for(const auto& i : rule.mirrors) mirrors.push_back(fill_link(i,mp));
+        ret.push_back({rule,s,mp,mirrors});
+    }
+    return ret;
+}
 
-        bool failed = false;
-        for(size_t j = 0; j < args.size(); ++j) {
-            if(j % 2 == 1) {
-                if(rule.symbols.size() == 0 || rule.symbols.front() != args[j].src[0]) { failed = true; break; }
-                rule.symbols.erase(rule.symbols.begin());
-            }
-            else mp[rule.rvpositions[j/2]] = args[j].src;
+static void write_strings(BinaryWriter& writer, const std::vector<std::string>& strings) {
+    writer.u32(strings.size());
+    for(const auto& i : strings) writer.str(i);
+}
+
+static std::vector<std::string> read_strings(BinaryReader& reader) {
+    std::vector<std::string> ret;
+    std::uint32_t count = reader.u32();
+    for(std::uint32_t i = 0; i < count && reader.good; ++i) ret.push_back(reader.str());
+    return ret;
+}
+
+static void write_link(BinaryWriter& writer, const Url& link) {
+    writer.u32(link.args);
+    write_strings(writer,link.placeholders);
+    write_strings(writer,link.url);
+}
+
+static Url read_link(BinaryReader& reader) {
+    Url link;
+    link.args = reader.u32();
+    link.placeholders = read_strings(reader);
+    link.url = read_strings(reader);
+    return link;
+}
+
+bool save_rules(const std::filesystem::path& path, std::uint64_t key, const RuleMatcher& matcher) {
+    BinaryWriter writer;
+    writer.str("CCRC").u64(key);
+
+    writer.u32(matcher.rules.size());
+    for(const auto& rule : matcher.rules) {
+        writer.str(rule.name).str(std::string(rule.symbols.begin(),rule.symbols.end()));
+        write_link(writer,rule.link);
+        writer.u32(rule.mirrors.size());
+        for(const auto& i : rule.mirrors) write_link(writer,i);
+        writer.u32(rule.positions.size());
+        for(const auto& i : rule.positions) writer.str(i.first).u32(i.second);
+        writer.u32(rule.rvpositions.size());
+        for(const auto& i : rule.rvpositions) writer.u32(i.first).str(i.second);
+        writer.u32(rule.defaults.size());
+        for(const auto& i : rule.defaults) writer.str(i.first).str(i.second);
+        write_strings(writer,rule.scripts);
+        writer.u32(rule.script_handle);
+        writer.u32(rule.embedded.size());
+        for(const auto& i : rule.embedded) writer.str(i.first).u32(i.second);
+    }
+
+    writer.u32(matcher.shapes.size());
+    for(const auto& [shape,rules] : matcher.shapes) {
+        writer.str(shape).u32(rules.size());
+        for(auto i : rules) writer.u32(i);
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(),ec);
+    return writer.to_file(path);
+}
+
+bool load_rules(const std::filesystem::path& path, std::uint64_t key, RuleMatcher& matcher) {
+    BinaryReader reader = BinaryReader::from_file(path);
+    if(reader.str() != "CCRC" || reader.u64() != key) return false;
+
+    RuleMatcher ret;
+    std::uint32_t count = reader.u32();
+    for(std::uint32_t i = 0; i < count && reader.good; ++i) {
+        Rule rule;
+        rule.name = reader.str();
+        std::string symbols = reader.str();
+        rule.symbols.assign(symbols.begin(),symbols.end());
+        rule.link = read_link(reader);
+        std::uint32_t size = reader.u32();
+        for(std::uint32_t j = 0; j < size && reader.good; ++j)
+            rule.mirrors.push_back(read_link(reader));
+        size = reader.u32();
+        for(std::uint32_t j = 0; j < size && reader.good; ++j) {
+            std::string name = reader.str();
+            rule.positions[name] = reader.u32();
         }
-        if(failed) continue;
-        for(auto j : mp) 
-            if(j.second == "") {
-                failed = true;
-                break;
-            }
-        
-        if(failed) continue;
-        
-        for(auto u : rule.link.url) {
-            if(u.front() == '{') {
-                u.erase(u.begin());
-                u.pop_back();
-                s += mp[u];
-            }
-            else s += u;
+        size = reader.u32();
+        for(std::uint32_t j = 0; j < size && reader.good; ++j) {
+            int pos = reader.u32();
+            rule.rvpositions[pos] = reader.str();
+        }
+        size = reader.u32();
+        for(std::uint32_t j = 0; j < size && reader.good; ++j) {
+            std::string name = reader.str();
+            rule.defaults[name] = reader.str();
         }
-        ret.push_back({rule,s,mp});
+        rule.scripts = read_strings(reader);
+        rule.script_handle = reader.u32();
+        size = reader.u32();
+        for(std::uint32_t j = 0; j < size && reader.good; ++j) {
+            std::string source = reader.str();
+            rule.embedded.push_back({source,(int)reader.u32()});
+        }
+        ret.rules.push_back(rule);
     }
-    return ret;
-}
\ No newline at end of file
+
+    count = reader.u32();
+    for(std::uint32_t i = 0; i < count && reader.good; ++i) {
+        auto& rules = ret.shapes[reader.str()];
+        std::uint32_t size = reader.u32();
+        for(std::uint32_t j = 0; j < size && reader.good; ++j) {
+            std::uint32_t index = reader.u32();
+            if(index >= ret.rules.size()) return false;
+            rules.push_back(index);
+        }
+    }
+    if(!reader.good || reader.pos != reader.data.size()) return false;
+    matcher = std::move(ret);
+    return true;
+}
@@ -0,0 +1,129 @@
+#include "../inc/sandbox.hpp"
+#include "../inc/threadpool.hpp"
+#include "../carescript/carescript-api.hpp"
+
+#include <iostream>
+#include <chrono>
+#include <mutex>
+
+#ifdef __linux__
+# include <unistd.h>
+# include <fcntl.h>
+# include <poll.h>
+# include <signal.h>
+# include <sys/wait.h>
+# include <sys/resource.h>
+# include <pthread.h>
+#endif
+
+// the wall clock limit of a sandboxed script if script_timeout is 0, a
+// child stuck on something is killed after it
+#define CATCARE_SANDBOX_TIMEOUT 300
+
+#ifdef __linux__
+// the child only keeps the forking thread, locks other threads held at
+// the fork would stay locked forever. the ones every script may need,
+// loading extensions and registering types, are taken before forking
+static void hold_script_locks() {
+    carescript::extension_mutex.lock();
+    carescript::_type_registry::mutex.lock();
+}
+
+static void release_script_locks() {
+    carescript::_type_registry::mutex.unlock();
+    carescript::extension_mutex.unlock();
+}
+#endif
+
+bool run_sandboxed(std::function<std::string(int& status)> fn, SandboxLimits limits, std::string& payload, std::string& error) {
+#ifdef __linux__
+    int fds[2];
+    // processes the script starts must not keep the pipe open
+    if(pipe2(fds,O_CLOEXEC) != 0) {
+        error = "can't create sandbox pipe";
+        return false;
+    }
+    static std::once_flag atfork;
+    std::call_once(atfork,[]() { pthread_atfork(hold_script_locks,release_script_locks,release_script_locks); });
+    unsigned int timeout = limits.timeout != 0 ? limits.timeout : CATCARE_SANDBOX_TIMEOUT;
+
+    // buffered output would otherwise be written by both processes
+    std::cout.flush();
+    pid_t pid = fork();
+    if(pid < 0) {
+        close(fds[0]);
+        close(fds[1]);
+        error = "can't fork sandbox";
+        return false;
+    }
+    if(pid == 0) {
+        close(fds[0]);
+        // own process group, so processes started by the script get killed too
+        setpgid(0,0);
+        ThreadPool::run_inline() = true;
+        if(limits.timeout != 0) {
+            rlimit cpu{limits.timeout,limits.timeout + 1};
+            setrlimit(RLIMIT_CPU,&cpu);
+        }
+        if(limits.memory != 0) {
+            rlimit memory{(rlim_t)limits.memory * 1024 * 1024,(rlim_t)limits.memory * 1024 * 1024};
+            setrlimit(RLIMIT_AS,&memory);
+        }
+        // exit handlers and static destructors of the parent must not run
+        // in here, the child always leaves through _exit
+        int code = 0;
+        std::string ret = fn(code);
+        std::cout.flush();
+        for(size_t written = 0; written < ret.size();) {
+            ssize_t n = write(fds[1],ret.data() + written,ret.size() - written);
+            if(n <= 0) break;
+            written += n;
+        }
+        close(fds[1]);
+        _exit(code);
+    }
+
+    close(fds[1]);
+    // a second of grace, so the interpreter can report its own time limit first
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeout + 1);
+    bool timed_out = false;
+    bool exited = false;
+    int status = 0;
+    char buffer[4096];
+    while(true) {
+        pollfd pfd{fds[0],POLLIN,0};
+        int ready = poll(&pfd,1,50);
+        if(ready > 0) {
+            ssize_t n = read(fds[0],buffer,sizeof(buffer));
+            if(n <= 0) break;
+            payload.append(buffer,n);
+        }
+        // the child is done even if something it left running still
+        // holds the pipe, whatever it wrote is read without waiting
+        if(waitpid(pid,&status,WNOHANG) == pid) {
+            exited = true;
+            fcntl(fds[0],F_SETFL,O_NONBLOCK);
+            for(ssize_t n; (n = read(fds[0],buffer,sizeof(buffer))) > 0;) payload.append(buffer,n);
+            break;
+        }
+        if(std::chrono::steady_clock::now() > deadline) {
+            kill(-pid,SIGKILL);
+            kill(pid,SIGKILL);
+            timed_out = true;
+            break;
+        }
+    }
+    close(fds[0]);
+
+    if(!exited) waitpid(pid,&status,0);
+    if(timed_out) error = "killed after " + std::to_string(timeout) + " seconds";
+    else if(WIFSIGNALED(status)) error = "killed by signal " + std::to_string(WTERMSIG(status));
+    else if(!WIFEXITED(status) || WEXITSTATUS(status) != 0) error = "exited with status " + std::to_string(WEXITSTATUS(status));
+    return error == "";
+#else
+    int code = 0;
+    payload = fn(code);
+    if(code != 0) error = "exited with status " + std::to_string(code);
+    return error == "";
+#endif
+}
@@ -0,0 +1,154 @@
+#include "../inc/scriptcache.hpp"
+#include "../inc/network.hpp"
+#include "../inc/options.hpp"
+#include "../inc/hashing.hpp"
+#include "../inc/serialize.hpp"
+
+#include <algorithm>
+
+using namespace carescript;
+
+std::string read_script(std::filesystem::path path) {
+    std::ifstream ifile(path,std::ios::binary);
+    if(!ifile) return "";
+    return std::string(std::istreambuf_iterator<char>(ifile),std::istreambuf_iterator<char>());
+}
+
+static std::uint64_t interpreter_fingerprint(const Interpreter& interp) {
+    std::uint64_t hash = fnv1a(CATCARE_SCRIPT_CACHE_VERSION);
+    for(const auto& i : interp.script_builtins)
+        hash = fnv1a(i.first + ";",hash);
+    for(const auto& i : interp.script_operators)
+        hash = fnv1a(i.first + ":" + std::to_string(i.second.size()) + ";",hash);
+
+    std::vector<std::string> macros;
+    for(const auto& i : interp.script_macros)
+        macros.push_back(i.first + "=" + i.second);
+    std::sort(macros.begin(),macros.end());
+    for(const auto& i : macros)
+        hash = fnv1a(i + ";",hash);
+
+    return fnv1a(std::to_string(interp.script_typechecks.size()),hash);
+}
+
+static void write_token(BinaryWriter& writer, const KittenToken& token) {
+    writer.str(token.src).u32(token.str).u32(token.line);
+}
+
+static KittenToken read_token(BinaryReader& reader) {
+    KittenToken token;
+    token.src = reader.str();
+    token.str = reader.u32();
+    token.line = reader.u32();
+    return token;
+}
+
+// the key only finds the entry, the length and digest of the source
+// make sure it really was made from this script
+static bool write_cache(std::filesystem::path path, std::uint64_t key, const std::string& source, const ScriptSettings& settings) {
+    BinaryWriter writer;
+    writer.str("CCSC").u64(key).u64(source.size()).str(sha256(source));
+
+    writer.u32(settings.directives.size());
+    for(const auto& i : settings.directives) {
+        writer.str(i.instruction).u32(i.line);
+        write_token(writer,i.body);
+    }
+
+    writer.u32(settings.labels.size());
+    for(const auto& [name,label] : settings.labels) {
+        writer.str(name).u32(label.line);
+        writer.u32(label.arglist.size());
+        for(const auto& i : label.arglist) writer.str(i);
+        writer.u32(label.statements.size());
+        for(const auto& i : label.statements) {
+            writer.str(i.function).u32(i.line).u64(i.jump);
+            write_token(writer,i.arguments);
+            writer.u32(i.expressions.size());
+            for(const auto& j : i.expressions) {
+                writer.str(j.source).u32(j.tokens.size());
+                for(const auto& k : j.tokens) write_token(writer,k);
+            }
+        }
+    }
+
+    std::error_code ec;
+    std::filesystem::create_directories(path.parent_path(),ec);
+    return writer.to_file(path);
+}
+
+static bool read_cache(std::filesystem::path path, std::uint64_t key, const std::string& source, ScriptTableVersion macros, std::vector<ScriptDirective>& directives, std::map<std::string,ScriptLabel>& labels) {
+    if(!std::filesystem::exists(path)) return false;
+    BinaryReader reader = BinaryReader::from_file(path);
+    if(reader.str() != "CCSC" || reader.u64() != key) return false;
+    if(reader.u64() != source.size() || reader.str() != sha256(source)) return false;
+
+    std::uint32_t count = reader.u32();
+    for(std::uint32_t i = 0; i < count && reader.good; ++i) {
+        ScriptDirective directive;
+        directive.instruction = reader.str();
+        directive.line = reader.u32();
+        directive.body = read_token(reader);
+        directives.push_back(directive);
+    }
+
+    count = reader.u32();
+    for(std::uint32_t i = 0; i < count && reader.good; ++i) {
+        ScriptLabel& label = labels[reader.str()];
+        label.line = reader.u32();
+        std::uint32_t args = reader.u32();
+        for(std::uint32_t j = 0; j < args && reader.good; ++j)
+            label.arglist.push_back(reader.str());
+        std::uint32_t statements = reader.u32();
+        for(std::uint32_t j = 0; j < statements && reader.good; ++j) {
+            ScriptStatement statement;
+            statement.function = reader.str();
+            statement.line = reader.u32();
+            statement.jump = reader.u64();
+            statement.arguments = read_token(reader);
+            std::uint32_t expressions = reader.u32();
+            for(std::uint32_t k = 0; k < expressions && reader.good; ++k) {
+                ScriptExpression expression;
+                expression.source = reader.str();
+                std::uint32_t tokens = reader.u32();
+                for(std::uint32_t l = 0; l < tokens && reader.good; ++l)
+                    expression.tokens.push_back(read_token(reader));
+                statement.expressions.push_back(expression);
+            }
+            // the key covers the macros, so they match the current ones
+            statement.macros = macros;
+            label.statements.push_back(statement);
+
+            KittenToken function;
+            function.src = statement.function;
+            function.line = statement.line;
+            label.lines.push_back(function);
+            label.lines.push_back(statement.arguments);
+        }
+    }
+    return reader.good && reader.pos == reader.data.size();
+}
+
+InterpreterError load_script(Interpreter& interp, const std::string& source) {
+    if(arg_settings::no_config || option_or("script_cache","true") != "true")
+        return interp.pre_process(source);
+
+    std::uint64_t key = fnv1a(source,interpreter_fingerprint(interp));
+    std::filesystem::path path = std::filesystem::path(CATCARE_CACHE_PATH) / "scripts" / to_hex(key);
+
+    std::vector<ScriptDirective> directives;
+    std::map<std::string,ScriptLabel> labels;
+    if(read_cache(path,key,source,interp.script_macros.version(),directives,labels)) {
+        interp.settings.error_msg = "";
+        for(const auto& i : directives) {
+            if(!run_directive(i,interp.settings)) return interp;
+        }
+        interp.settings.directives = directives;
+        interp.settings.labels = labels;
+        return interp;
+    }
+
+    interp.pre_process(source);
+    if(interp) write_cache(path,key,source,interp.settings);
+    return interp;
+}
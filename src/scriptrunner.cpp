@@ -0,0 +1,178 @@
+#include "../inc/scriptrunner.hpp"
+#include "../inc/scriptcache.hpp"
+#include "../inc/threadpool.hpp"
+#include "../inc/configs.hpp"
+#include "../inc/options.hpp"
+#include "../inc/sandbox.hpp"
+
+#include <sstream>
+#include <fstream>
+#include <iomanip>
+
+using namespace carescript;
+
+static unsigned long option_number(std::string option, unsigned long els) {
+    try {
+        return std::stoul(option_or(option,std::to_string(els)));
+    }
+    catch(...) {}
+    return els;
+}
+
+static bool sandboxed() {
+    return option_or("script_sandbox","false") == "true";
+}
+
+static SandboxLimits sandbox_limits() {
+    SandboxLimits limits;
+    limits.timeout = option_number("script_timeout",0);
+    limits.memory = option_number("script_memory_limit",0);
+    return limits;
+}
+
+void limit_script(Interpreter& interp) {
+    interp.budget = std::make_shared<ScriptBudget>();
+    interp.budget->max_instructions = option_number("script_max_instructions",0);
+    interp.budget->max_depth = option_number("script_max_depth",256);
+    unsigned long timeout = option_number("script_timeout",0);
+    if(timeout != 0)
+        interp.budget->deadline = std::chrono::steady_clock::now() + std::chrono::seconds(timeout);
+    interp.profiler = script_profiler();
+}
+
+// a script calling exit with a status other than 0 failed
+static std::string run_error(const Interpreter& interp) {
+    if(interp.error() != "") return interp.error();
+    if(interp.exit_code && *interp.exit_code != 0) return "exited with status " + std::to_string(*interp.exit_code);
+    return "";
+}
+
+std::string run_limited(Interpreter& interp, std::string label, ScriptArglist args) {
+    limit_script(interp);
+    if(!sandboxed()) {
+        interp.run(label,args);
+        return run_error(interp);
+    }
+
+    std::string payload, error;
+    if(!run_sandboxed([&](int& status) {
+        interp.run(label,args);
+        if(interp.exit_code) status = *interp.exit_code;
+        return interp.error();
+    },sandbox_limits(),payload,error)) {
+        return "sandbox: " + error;
+    }
+    return payload;
+}
+
+static IsolatedResult run_one(const IsolatedScript& script) {
+    IsolatedResult result;
+    std::ostringstream output;
+    Interpreter interp(script_prototype());
+    interp.output = &output;
+
+    load_script(interp,script.source);
+    if(interp) {
+        limit_script(interp);
+        interp.run(script.label,script.args);
+    }
+    result.error = run_error(interp);
+    result.output = output.str();
+    return result;
+}
+
+// the child sends the output and the error back separated by a null byte
+static IsolatedResult run_one_sandboxed(const IsolatedScript& script) {
+    IsolatedResult result;
+    std::string payload, error;
+    if(!run_sandboxed([&](int&) {
+        IsolatedResult r = run_one(script);
+        return r.output + '\0' + r.error;
+    },sandbox_limits(),payload,error)) {
+        result.output = payload;
+        result.error = "sandbox: " + error;
+        return result;
+    }
+    size_t split = payload.find('\0');
+    result.output = payload.substr(0,split);
+    if(split != std::string::npos) result.error = payload.substr(split + 1);
+    return result;
+}
+
+std::vector<IsolatedResult> run_isolated(const std::vector<IsolatedScript>& scripts) {
+    if(scripts.empty()) return {};
+    // built once up front instead of racing on the first use
+    script_prototype();
+
+    // a pool of its own, scripts may wait on the shared worker pool
+    ThreadPool pool(std::min<size_t>(scripts.size(),std::max(2u,std::thread::hardware_concurrency())));
+    std::vector<std::future<IsolatedResult>> running;
+    for(const auto& i : scripts) {
+        running.push_back(pool.submit([&i]() { return sandboxed() ? run_one_sandboxed(i) : run_one(i); }));
+    }
+
+    std::vector<IsolatedResult> results;
+    for(auto& i : running) results.push_back(i.get());
+    return results;
+}
+
+void print_isolated(const std::vector<IsolatedScript>& scripts, const std::vector<IsolatedResult>& results, std::string what) {
+    for(size_t i = 0; i < results.size(); ++i) {
+        print_message("INFO","Output of " + what + ": \"" + scripts[i].name + "\"");
+        std::cout << results[i].output;
+        if(results[i].error != "")
+            print_message("ERROR",what + " " + scripts[i].name + " failed:\n" + results[i].error);
+    }
+}
+
+std::shared_ptr<ScriptProfiler> script_profiler() {
+    static std::shared_ptr<ScriptProfiler> profiler = arg_settings::profile_scripts ? std::make_shared<ScriptProfiler>() : nullptr;
+    return profiler;
+}
+
+static std::string milliseconds(std::chrono::nanoseconds time) {
+    std::ostringstream str;
+    str << std::fixed << std::setprecision(3) << time.count() / 1e6;
+    return str.str();
+}
+
+void report_profile(std::filesystem::path file) {
+    auto profiler = script_profiler();
+    if(!profiler) return;
+
+    using Entry = ScriptProfiler::Entry;
+    auto by_time = [](const std::map<std::string,Entry>& entries) {
+        std::vector<std::pair<std::string,Entry>> ret(entries.begin(),entries.end());
+        std::sort(ret.begin(),ret.end(),[](const auto& a, const auto& b) {
+            return a.second.inclusive > b.second.inclusive;
+        });
+        return ret;
+    };
+
+    std::cout << "\n" << std::left
+        << std::setw(24) << "label" << std::setw(10) << "calls" 
+        << std::setw(16) << "inclusive (ms)" << "exclusive (ms)\n";
+    for(const auto& i : by_time(profiler->labels)) {
+        std::cout << std::setw(24) << i.first << std::setw(10) << i.second.calls
+            << std::setw(16) << milliseconds(i.second.inclusive) << milliseconds(i.second.exclusive) << "\n";
+    }
+
+    std::cout << "\n" << std::setw(24) << "builtin" << std::setw(10) << "calls" << "time (ms)\n";
+    for(const auto& i : by_time(profiler->builtins)) {
+        std::cout << std::setw(24) << i.first << std::setw(10) << i.second.calls
+            << milliseconds(i.second.inclusive) << "\n";
+    }
+
+    std::cout << "\n" << std::setw(24) << "argument evaluation" << std::setw(10) << profiler->expressions.calls
+        << milliseconds(profiler->expressions.exclusive) << "\n\n";
+
+    std::ofstream out(file);
+    if(!out) {
+        print_message("ERROR","Can't write the profile to " + file.string());
+        return;
+    }
+    for(const auto& i : profiler->folded) {
+        out << i.first << " " << std::chrono::duration_cast<std::chrono::microseconds>(i.second).count() << "\n";
+    }
+    print_message("INFO","Folded stacks written to " + file.string());
+}
@@ -0,0 +1,47 @@
+#include "../inc/transfer.hpp"
+#include "../inc/network.hpp"
+#include "../inc/options.hpp"
+#include "../inc/mirrors.hpp"
+
+#ifdef __linux__
+#include <curl/curl.h>
+#endif
+
+TransferEngine::TransferEngine(size_t connections): pool(connections) {
+#ifdef __linux__
+    // not thread safe, so it has to happen before the first transfer starts
+    curl_global_init(CURL_GLOBAL_DEFAULT);
+#endif
+}
+
+std::shared_future<bool> TransferEngine::enqueue(std::string url, std::string file) {
+    return pool.submit([url,file]() {
+        return download_page(url,file);
+    }).share();
+}
+
+std::shared_future<bool> TransferEngine::enqueue(std::vector<std::string> links, std::string path, std::string file) {
+    return pool.submit([links,path,file]() {
+        for(size_t i = 0; i < links.size(); ++i) {
+            // a failing mirror is left for the next one right away, only
+            // the last one gets retried
+            std::chrono::milliseconds first_byte{0};
+            bool success = download_page(links[i] + path,file,i + 1 == links.size(),&first_byte);
+            record_mirror(links[i],success,first_byte);
+            if(success) return true;
+        }
+        return false;
+    }).share();
+}
+
+TransferEngine& transfer_engine() {
+    static TransferEngine engine([]() -> size_t {
+        try {
+            int connections = std::stoi(option_or("download_connections","4"));
+            if(connections > 0) return connections;
+        }
+        catch(...) {}
+        return 4;
+    }());
+    return engine;
+}